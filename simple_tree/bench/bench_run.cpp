@@ -0,0 +1,124 @@
+// Runs one simple_tree command for run_bench.sh and prints a JSON result:
+//
+//   bench_run <shim.so> <entries> <repeat> <label-json> [--stdout=pipe|null] -- <cmd> [args...]
+//
+// The command runs repeat times with stdout drained through a pipe, or
+// sent straight to /dev/null with --stdout=null (output_bytes then comes
+// from the warm-up run, which always goes through the pipe); wall time is
+// the median run, peak RSS the largest. Syscall counts come from
+// the count_shim preloaded into the last run. label-json is a JSON object
+// body (e.g. "\"shape\":\"wide\"") copied into the result.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+struct RunResult{
+    double wall;
+    long maxrss_kb;
+    long long out_bytes;
+    int status;
+};
+
+RunResult run_once(char** cmd, const char* shim, const char* counts_file, bool to_null){
+    int pipefd[2];
+    if(to_null){
+        pipefd[0] = -1;
+        pipefd[1] = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if(pipefd[1] == -1){perror("/dev/null"); exit(1);}
+    }
+    else if(pipe(pipefd) == -1){perror("pipe"); exit(1);}
+    auto t0 = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if(pid == 0){
+        dup2(pipefd[1], STDOUT_FILENO);
+        if(pipefd[0] != -1){close(pipefd[0]);}
+        close(pipefd[1]);
+        if(shim){
+            setenv("LD_PRELOAD", shim, 1);
+            setenv("COUNT_SHIM_OUT", counts_file, 1);
+        }
+        execvp(cmd[0], cmd);
+        perror(cmd[0]);
+        _exit(127);
+    }
+    close(pipefd[1]);
+    RunResult r = {0, 0, 0, 0};
+    if(pipefd[0] != -1){
+        std::vector<char> buf(1 << 20);
+        ssize_t n;
+        while((n = read(pipefd[0], buf.data(), buf.size())) > 0){r.out_bytes += n;}
+        close(pipefd[0]);
+    }
+    struct rusage ru;
+    wait4(pid, &r.status, 0, &ru);
+    r.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    r.maxrss_kb = ru.ru_maxrss;
+    return r;
+}
+
+int main(int argc, char** argv){
+    int sep = 5;
+    bool to_null = false;
+    if(argc > 5 && strncmp(argv[5], "--stdout=", 9) == 0){
+        if(strcmp(argv[5] + 9, "null") == 0){to_null = true;}
+        else if(strcmp(argv[5] + 9, "pipe") != 0){sep = argc;}
+        ++sep;
+    }
+    if(argc < sep + 2 || strcmp(argv[sep], "--") != 0){
+        fprintf(stderr, "usage: %s <shim.so> <entries> <repeat> <label-json> [--stdout=pipe|null] -- <cmd> [args...]\n",
+                argv[0]);
+        return 2;
+    }
+    const char* shim = argv[1];
+    long long entries = atoll(argv[2]);
+    int repeat = std::max(1, atoi(argv[3]));
+    const char* label = argv[4];
+    char** cmd = argv + sep + 1;
+    std::string counts_file = "/tmp/bench_counts." + std::to_string(getpid());
+
+    // Warms the dentry/inode caches and measures the output.
+    long long out_bytes = run_once(cmd, nullptr, nullptr, false).out_bytes;
+    std::vector<double> walls;
+    RunResult last = {0, 0, 0, 0};
+    long maxrss = 0;
+    for(int i=0;i<repeat;++i){
+        last = run_once(cmd, nullptr, nullptr, to_null);
+        walls.push_back(last.wall);
+        maxrss = std::max(maxrss, last.maxrss_kb);
+    }
+    std::sort(walls.begin(), walls.end());
+    double wall = walls[walls.size() / 2];
+    run_once(cmd, shim, counts_file.c_str(), to_null);
+
+    std::string counts = "{}";
+    long long syscalls = 0;
+    if(FILE* f = fopen(counts_file.c_str(), "r")){
+        char line[1024];
+        if(fgets(line, sizeof(line), f)){
+            counts = line;
+            while(!counts.empty() && counts.back() == '\n'){counts.pop_back();}
+            for(const char* p=line; (p = strchr(p, ':')); ++p){syscalls += atoll(p + 1);}
+        }
+        fclose(f);
+        unlink(counts_file.c_str());
+    }
+
+    printf("{%s,\"stdout\":\"%s\",\"cmd\":\"", label, to_null ? "null" : "pipe");
+    for(char** a=cmd; *a; ++a){printf("%s%s", a == cmd ? "" : " ", *a);}
+    printf("\",\"exit\":%d,\"entries\":%lld,\"runs\":%d,\"wall_s\":%.6f,\"entries_per_sec\":%.0f,"
+           "\"syscalls\":%s,\"syscalls_per_entry\":%.3f,\"peak_rss_kb\":%ld,"
+           "\"output_bytes\":%lld,\"output_bytes_per_sec\":%.0f}\n",
+           WIFEXITED(last.status) ? WEXITSTATUS(last.status) : -1, entries, repeat, wall,
+           wall > 0 ? entries / wall : 0, counts.c_str(),
+           entries ? (double)syscalls / entries : 0, maxrss, out_bytes,
+           wall > 0 ? out_bytes / wall : 0);
+    return 0;
+}
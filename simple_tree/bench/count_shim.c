@@ -0,0 +1,84 @@
+// LD_PRELOAD shim counting the syscalls simple_tree makes, for run_bench.sh.
+// Counts are written as one JSON object to $COUNT_SHIM_OUT at exit.
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+enum{C_GETDENTS, C_STAT, C_OPEN, C_READLINK, C_WRITE, C_URING, C_OTHER_SYSCALL, C_COUNT};
+static const char* const names[C_COUNT] = {
+    "getdents64", "stat", "open", "readlink", "write", "io_uring_enter", "other_syscall"
+};
+static long counts[C_COUNT];
+
+#define COUNT(c) __atomic_add_fetch(&counts[c], 1, __ATOMIC_RELAXED)
+#define REAL(name) static __typeof__(name)* real; if(!real){real = dlsym(RTLD_NEXT, #name);}
+
+int fstatat(int dirfd, const char* path, struct stat* st, int flags){
+    REAL(fstatat); COUNT(C_STAT); return real(dirfd, path, st, flags);
+}
+int fstatat64(int dirfd, const char* path, struct stat64* st, int flags){
+    REAL(fstatat64); COUNT(C_STAT); return real(dirfd, path, st, flags);
+}
+int stat(const char* path, struct stat* st){REAL(stat); COUNT(C_STAT); return real(path, st);}
+int lstat(const char* path, struct stat* st){REAL(lstat); COUNT(C_STAT); return real(path, st);}
+int fstat(int fd, struct stat* st){REAL(fstat); COUNT(C_STAT); return real(fd, st);}
+
+int open(const char* path, int flags, ...){
+    REAL(open);
+    va_list ap;
+    va_start(ap, flags);
+    mode_t mode = va_arg(ap, mode_t);
+    va_end(ap);
+    COUNT(C_OPEN);
+    return real(path, flags, mode);
+}
+int openat(int dirfd, const char* path, int flags, ...){
+    REAL(openat);
+    va_list ap;
+    va_start(ap, flags);
+    mode_t mode = va_arg(ap, mode_t);
+    va_end(ap);
+    COUNT(C_OPEN);
+    return real(dirfd, path, flags, mode);
+}
+
+ssize_t readlinkat(int dirfd, const char* path, char* buf, size_t n){
+    REAL(readlinkat); COUNT(C_READLINK); return real(dirfd, path, buf, n);
+}
+ssize_t readlink(const char* path, char* buf, size_t n){
+    REAL(readlink); COUNT(C_READLINK); return real(path, buf, n);
+}
+
+ssize_t write(int fd, const void* buf, size_t n){REAL(write); COUNT(C_WRITE); return real(fd, buf, n);}
+ssize_t writev(int fd, const struct iovec* iov, int cnt){REAL(writev); COUNT(C_WRITE); return real(fd, iov, cnt);}
+
+long syscall(long no, ...){
+    REAL(syscall);
+    va_list ap;
+    va_start(ap, no);
+    long a[6];
+    for(int i=0;i<6;++i){a[i] = va_arg(ap, long);}
+    va_end(ap);
+    if(no == SYS_getdents64){COUNT(C_GETDENTS);}
+    else if(no == SYS_io_uring_enter){COUNT(C_URING);}
+    else{COUNT(C_OTHER_SYSCALL);}
+    return real(no, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+__attribute__((destructor)) static void report(void){
+    const char* file = getenv("COUNT_SHIM_OUT");
+    if(!file){return;}
+    FILE* f = fopen(file, "w");
+    if(!f){return;}
+    fputc('{', f);
+    for(int i=0;i<C_COUNT;++i){fprintf(f, "%s\"%s\":%ld", i ? "," : "", names[i], counts[i]);}
+    fputs("}\n", f);
+    fclose(f);
+}
@@ -0,0 +1,322 @@
+// Read-only FUSE passthrough that answers every request after a fixed delay,
+// for run_bench.sh: a stand-in for a high-latency mount (NFS, sshfs, a FUSE
+// backend over the network) on which --uring and -j can be measured. It
+// speaks the kernel protocol on /dev/fuse directly, so it needs root (to
+// mount) but not libfuse.
+//
+//   delay_fs <source> <mountpoint> <delay_us> [threads]
+//
+// Mounts source at mountpoint and returns once the mount is up; the server
+// keeps running in the background until the mountpoint is unmounted
+// (umount <mountpoint>). Up to threads (default 64) requests are served
+// at once, each one taking delay_us. Entries are not cached by the kernel
+// (entry timeout 0), so every stat of a name is a LOOKUP round trip, as on
+// a mount that revalidates names; attributes are cached for a second.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <climits>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/uio.h>
+#include <linux/fuse.h>
+
+int fuse_fd = -1, src_fd = -1;
+long delay_us = 0;
+
+// nodeid -> path below source ("." for the root). Forgets are ignored: a
+// benchmark tree is small enough to keep every name it ever looked up.
+std::mutex nodes_mtx;
+std::vector<std::string> node_paths = {"", "."}; // nodeid 0 is unused
+std::unordered_map<std::string, uint64_t> node_ids = {{".", FUSE_ROOT_ID}};
+
+std::string node_path(uint64_t id){
+    std::lock_guard<std::mutex> lock(nodes_mtx);
+    return id < node_paths.size() ? node_paths[id] : std::string();
+}
+
+uint64_t node_id(const std::string& path){
+    std::lock_guard<std::mutex> lock(nodes_mtx);
+    auto it = node_ids.find(path);
+    if(it != node_ids.end()){return it->second;}
+    node_paths.push_back(path);
+    node_ids.emplace(path, node_paths.size() - 1);
+    return node_paths.size() - 1;
+}
+
+struct DirListing{
+    struct Entry{
+        uint64_t ino;
+        uint32_t type;
+        std::string name;
+    };
+    std::vector<Entry> entries;
+};
+
+void fill_attr(fuse_attr& a, const struct stat& st){
+    memset(&a, 0, sizeof(a));
+    a.ino = st.st_ino;
+    a.size = st.st_size;
+    a.blocks = st.st_blocks;
+    a.atime = st.st_atim.tv_sec; a.atimensec = st.st_atim.tv_nsec;
+    a.mtime = st.st_mtim.tv_sec; a.mtimensec = st.st_mtim.tv_nsec;
+    a.ctime = st.st_ctim.tv_sec; a.ctimensec = st.st_ctim.tv_nsec;
+    a.mode = st.st_mode;
+    a.nlink = st.st_nlink;
+    a.uid = st.st_uid;
+    a.gid = st.st_gid;
+    a.rdev = st.st_rdev;
+    a.blksize = st.st_blksize;
+}
+
+void reply(const fuse_in_header& in, int err, const void* data = nullptr, size_t size = 0){
+    fuse_out_header out;
+    out.len = sizeof(out) + (err ? 0 : size);
+    out.error = -err;
+    out.unique = in.unique;
+    struct iovec iov[2] = {{&out, sizeof(out)}, {const_cast<void*>(data), err ? 0 : size}};
+    if(writev(fuse_fd, iov, 2) == -1 && errno != ENOENT){perror("delay_fs: reply");}
+}
+
+void handle(const fuse_in_header& in, const char* arg){
+    switch(in.opcode){
+    case FUSE_INIT:{
+        const fuse_init_in* init = reinterpret_cast<const fuse_init_in*>(arg);
+        fuse_init_out out;
+        memset(&out, 0, sizeof(out));
+        out.major = FUSE_KERNEL_VERSION;
+        out.minor = std::min<uint32_t>(init->minor, FUSE_KERNEL_MINOR_VERSION);
+        out.max_readahead = init->max_readahead;
+        out.max_background = 64;
+        out.congestion_threshold = 48;
+        out.max_write = 1 << 17;
+        out.time_gran = 1;
+        reply(in, 0, &out, sizeof(out));
+        return;
+    }
+    case FUSE_FORGET:
+    case FUSE_BATCH_FORGET:
+    case FUSE_INTERRUPT:
+        return; // no reply
+    case FUSE_DESTROY:
+        reply(in, 0);
+        return;
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+    std::string path = node_path(in.nodeid);
+    if(path.empty()){
+        reply(in, ENOENT);
+        return;
+    }
+    switch(in.opcode){
+    case FUSE_LOOKUP:{
+        std::string child = (path == "." ? std::string() : path + "/") + arg;
+        struct stat st;
+        if(fstatat(src_fd, child.c_str(), &st, AT_SYMLINK_NOFOLLOW) == -1){
+            reply(in, errno);
+            return;
+        }
+        fuse_entry_out out;
+        memset(&out, 0, sizeof(out));
+        out.nodeid = node_id(child);
+        out.attr_valid = 1;
+        fill_attr(out.attr, st);
+        reply(in, 0, &out, sizeof(out));
+        return;
+    }
+    case FUSE_GETATTR:{
+        struct stat st;
+        if(fstatat(src_fd, path.c_str(), &st, AT_SYMLINK_NOFOLLOW) == -1){
+            reply(in, errno);
+            return;
+        }
+        fuse_attr_out out;
+        memset(&out, 0, sizeof(out));
+        out.attr_valid = 1;
+        fill_attr(out.attr, st);
+        reply(in, 0, &out, sizeof(out));
+        return;
+    }
+    case FUSE_READLINK:{
+        char target[PATH_MAX];
+        ssize_t n = readlinkat(src_fd, path.c_str(), target, sizeof(target));
+        if(n == -1){reply(in, errno);}
+        else{reply(in, 0, target, n);}
+        return;
+    }
+    case FUSE_OPENDIR:{
+        int fd = openat(src_fd, path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        DIR* d = fd == -1 ? nullptr : fdopendir(fd);
+        if(!d){
+            int err = errno;
+            if(fd != -1){close(fd);}
+            reply(in, err);
+            return;
+        }
+        auto* listing = new DirListing;
+        while(struct dirent* e = readdir(d)){
+            listing->entries.push_back({e->d_ino, e->d_type, e->d_name});
+        }
+        closedir(d);
+        fuse_open_out out;
+        memset(&out, 0, sizeof(out));
+        out.fh = reinterpret_cast<uint64_t>(listing);
+        reply(in, 0, &out, sizeof(out));
+        return;
+    }
+    case FUSE_READDIR:{
+        const fuse_read_in* rd = reinterpret_cast<const fuse_read_in*>(arg);
+        const DirListing* listing = reinterpret_cast<const DirListing*>(rd->fh);
+        std::vector<char> buf(rd->size);
+        size_t used = 0;
+        for(size_t i=rd->offset;i<listing->entries.size();++i){
+            const auto& e = listing->entries[i];
+            size_t rec = FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + e.name.size());
+            if(used + rec > buf.size()){break;}
+            fuse_dirent* d = reinterpret_cast<fuse_dirent*>(buf.data() + used);
+            memset(d, 0, rec);
+            d->ino = e.ino;
+            d->off = i + 1;
+            d->namelen = e.name.size();
+            d->type = e.type;
+            memcpy(d->name, e.name.data(), e.name.size());
+            used += rec;
+        }
+        reply(in, 0, buf.data(), used);
+        return;
+    }
+    case FUSE_RELEASEDIR:{
+        const fuse_release_in* rel = reinterpret_cast<const fuse_release_in*>(arg);
+        delete reinterpret_cast<DirListing*>(rel->fh);
+        reply(in, 0);
+        return;
+    }
+    case FUSE_OPEN:{
+        const fuse_open_in* op = reinterpret_cast<const fuse_open_in*>(arg);
+        if((op->flags & O_ACCMODE) != O_RDONLY){
+            reply(in, EROFS);
+            return;
+        }
+        int fd = openat(src_fd, path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd == -1){
+            reply(in, errno);
+            return;
+        }
+        fuse_open_out out;
+        memset(&out, 0, sizeof(out));
+        out.fh = fd;
+        reply(in, 0, &out, sizeof(out));
+        return;
+    }
+    case FUSE_READ:{
+        const fuse_read_in* rd = reinterpret_cast<const fuse_read_in*>(arg);
+        std::vector<char> buf(rd->size);
+        ssize_t n = pread(rd->fh, buf.data(), buf.size(), rd->offset);
+        if(n == -1){reply(in, errno);}
+        else{reply(in, 0, buf.data(), n);}
+        return;
+    }
+    case FUSE_RELEASE:{
+        const fuse_release_in* rel = reinterpret_cast<const fuse_release_in*>(arg);
+        close(rel->fh);
+        reply(in, 0);
+        return;
+    }
+    case FUSE_FLUSH:
+        reply(in, 0);
+        return;
+    case FUSE_STATFS:{
+        struct statvfs sv;
+        if(fstatvfs(src_fd, &sv) == -1){
+            reply(in, errno);
+            return;
+        }
+        fuse_statfs_out out;
+        memset(&out, 0, sizeof(out));
+        out.st.blocks = sv.f_blocks;
+        out.st.bfree = sv.f_bfree;
+        out.st.bavail = sv.f_bavail;
+        out.st.files = sv.f_files;
+        out.st.ffree = sv.f_ffree;
+        out.st.bsize = sv.f_bsize;
+        out.st.namelen = sv.f_namemax;
+        out.st.frsize = sv.f_frsize;
+        reply(in, 0, &out, sizeof(out));
+        return;
+    }
+    default:
+        reply(in, ENOSYS);
+    }
+}
+
+void serve(){
+    std::vector<char> buf(FUSE_MIN_READ_BUFFER + (1 << 17));
+    while(true){
+        ssize_t n = read(fuse_fd, buf.data(), buf.size());
+        if(n == -1){
+            if(errno == EINTR || errno == ENOENT || errno == EAGAIN){continue;}
+            if(errno != ENODEV){perror("delay_fs: read");}
+            return; // ENODEV: unmounted
+        }
+        if((size_t)n < sizeof(fuse_in_header)){continue;}
+        const fuse_in_header* in = reinterpret_cast<const fuse_in_header*>(buf.data());
+        handle(*in, buf.data() + sizeof(fuse_in_header));
+    }
+}
+
+int main(int argc, char** argv){
+    if(argc < 4){
+        fprintf(stderr, "usage: %s <source> <mountpoint> <delay_us> [threads]\n", argv[0]);
+        return 2;
+    }
+    const char* source = argv[1];
+    const char* mountpoint = argv[2];
+    delay_us = atol(argv[3]);
+    int threads = argc > 4 ? std::max(1, atoi(argv[4])) : 64;
+
+    src_fd = open(source, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(src_fd == -1){
+        perror(source);
+        return 1;
+    }
+    fuse_fd = open("/dev/fuse", O_RDWR | O_CLOEXEC);
+    if(fuse_fd == -1){
+        perror("/dev/fuse");
+        return 1;
+    }
+    std::string opts = "fd=" + std::to_string(fuse_fd) + ",rootmode=40000,user_id=" + std::to_string(getuid())
+                     + ",group_id=" + std::to_string(getgid()) + ",allow_other";
+    if(mount("delay_fs", mountpoint, "fuse.delay_fs", MS_RDONLY | MS_NOSUID | MS_NODEV, opts.c_str()) == -1){
+        perror(mountpoint);
+        return 1;
+    }
+    pid_t pid = fork();
+    if(pid == -1){
+        perror("fork");
+        umount2(mountpoint, MNT_DETACH);
+        return 1;
+    }
+    if(pid > 0){return 0;}
+    setsid();
+    int null_fd = open("/dev/null", O_RDWR);
+    dup2(null_fd, STDIN_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+    std::vector<std::thread> workers;
+    for(int i=0;i<threads;++i){workers.emplace_back(serve);}
+    for(auto& t : workers){t.join();}
+    return 0;
+}
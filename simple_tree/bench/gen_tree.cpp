@@ -0,0 +1,176 @@
+// Builds a synthetic tree for run_bench.sh and prints the number of entries
+// below the root (what simple_tree will list).
+//
+//   gen_tree <shape> <dir> [scale]
+//
+// shapes (sizes at scale 1):
+//   wide       one directory with 200k empty files
+//   deep       a 2000-level chain, two files per level
+//   symlinks   20k files in 100 dirs plus 100k symlinks to them, most of
+//              them sharing a few hot targets (nix store / virtualenv style)
+//   hardlinks  10k files with 10 names each, spread over 100 dirs
+//   tiny       1M one-byte files, 1000 per directory, fan-out 10
+//   monorepo   100 packages with src/ (tracked), build/ and node_modules/
+//              (ignored by the root .gitignore) and a per-package
+//              .gitignore for *.log; about 63k entries, 3.3k not ignored
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+long entries = 0;
+
+void make_dir(const std::string& path){
+    if(mkdir(path.c_str(), 0755) == -1){
+        perror(path.c_str());
+        exit(1);
+    }
+}
+
+void make_file(const std::string& path, int bytes){
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1){
+        perror(path.c_str());
+        exit(1);
+    }
+    if(bytes > 0 && write(fd, "xxxxxxxxxxxxxxxx", bytes) != bytes){
+        perror(path.c_str());
+        exit(1);
+    }
+    close(fd);
+}
+
+void gen_wide(const std::string& root, long scale){
+    for(long i=0;i<200000*scale;++i){make_file(root + "/f" + std::to_string(i), 0); ++entries;}
+}
+
+void gen_deep(const std::string& root, long scale){
+    std::string dir = root;
+    for(long d=0;d<2000*scale;++d){
+        make_file(dir + "/a", 0);
+        make_file(dir + "/b", 0);
+        dir += "/d";
+        make_dir(dir);
+        entries += 3;
+    }
+}
+
+void gen_symlinks(const std::string& root, long scale){
+    const long dirs = 100, files = 20000 * scale, links = 100000 * scale;
+    for(long d=0;d<dirs;++d){make_dir(root + "/pkg" + std::to_string(d)); ++entries;}
+    for(long i=0;i<files;++i){
+        make_file(root + "/pkg" + std::to_string(i % dirs) + "/lib" + std::to_string(i) + ".so", 16);
+        ++entries;
+    }
+    make_dir(root + "/env");
+    ++entries;
+    for(long i=0;i<links;++i){
+        // 90% of the links point at one of 50 hot targets.
+        long target = (i % 10 != 0) ? i % 50 : (i * 7919) % files;
+        std::string to = "../pkg" + std::to_string(target % dirs) + "/lib" + std::to_string(target) + ".so";
+        std::string from = root + "/env/l" + std::to_string(i);
+        if(symlink(to.c_str(), from.c_str()) == -1){
+            perror(from.c_str());
+            exit(1);
+        }
+        ++entries;
+    }
+}
+
+void gen_hardlinks(const std::string& root, long scale){
+    const long dirs = 100, files = 10000 * scale, names = 10;
+    for(long d=0;d<dirs;++d){make_dir(root + "/d" + std::to_string(d)); ++entries;}
+    for(long i=0;i<files;++i){
+        std::string first = root + "/d" + std::to_string(i % dirs) + "/f" + std::to_string(i);
+        make_file(first, 16);
+        ++entries;
+        for(long k=1;k<names;++k){
+            std::string other = root + "/d" + std::to_string((i + k) % dirs) + "/h" + std::to_string(i) + "_" + std::to_string(k);
+            if(link(first.c_str(), other.c_str()) == -1){
+                perror(other.c_str());
+                exit(1);
+            }
+            ++entries;
+        }
+    }
+}
+
+// Directories are filled breadth-first, 10 subdirectories each, until the
+// file budget is spent.
+void gen_tiny(const std::string& root, long scale){
+    long files = 1000000 * scale, per_dir = 1000, made = 0;
+    std::vector<std::string> queue = {root};
+    for(size_t q=0;q<queue.size() && made<files;++q){
+        for(long i=0;i<per_dir && made<files;++i,++made){
+            make_file(queue[q] + "/t" + std::to_string(i), 1);
+            ++entries;
+        }
+        for(int k=0;k<10 && made<files;++k){
+            queue.push_back(queue[q] + "/s" + std::to_string(k));
+            make_dir(queue.back());
+            ++entries;
+        }
+    }
+}
+
+void write_file(const std::string& path, const char* text){
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1 || write(fd, text, strlen(text)) != (ssize_t)strlen(text)){
+        perror(path.c_str());
+        exit(1);
+    }
+    close(fd);
+}
+
+void gen_monorepo(const std::string& root, long scale){
+    write_file(root + "/.gitignore", "build/\nnode_modules/\n");
+    ++entries;
+    for(long p=0;p<100*scale;++p){
+        std::string pkg = root + "/pkg" + std::to_string(p);
+        make_dir(pkg);
+        write_file(pkg + "/.gitignore", "*.log\n");
+        make_file(pkg + "/npm-debug.log", 16);
+        make_file(pkg + "/build.log", 16);
+        make_dir(pkg + "/src");
+        entries += 5;
+        for(int i=0;i<30;++i){make_file(pkg + "/src/mod" + std::to_string(i) + ".ts", 16); ++entries;}
+        make_dir(pkg + "/build");
+        ++entries;
+        for(int i=0;i<80;++i){make_file(pkg + "/build/mod" + std::to_string(i) + ".js", 16); ++entries;}
+        make_dir(pkg + "/node_modules");
+        ++entries;
+        for(int m=0;m<10;++m){
+            std::string dep = pkg + "/node_modules/dep" + std::to_string(m);
+            make_dir(dep);
+            ++entries;
+            for(int i=0;i<50;++i){make_file(dep + "/f" + std::to_string(i) + ".js", 16); ++entries;}
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    if(argc < 3){
+        fprintf(stderr, "usage: %s wide|deep|symlinks|hardlinks|tiny|monorepo <dir> [scale]\n", argv[0]);
+        return 2;
+    }
+    std::string shape = argv[1], root = argv[2];
+    long scale = argc > 3 ? atol(argv[3]) : 1;
+    if(scale < 1){scale = 1;}
+    make_dir(root);
+    if(shape == "wide"){gen_wide(root, scale);}
+    else if(shape == "deep"){gen_deep(root, scale);}
+    else if(shape == "symlinks"){gen_symlinks(root, scale);}
+    else if(shape == "hardlinks"){gen_hardlinks(root, scale);}
+    else if(shape == "tiny"){gen_tiny(root, scale);}
+    else if(shape == "monorepo"){gen_monorepo(root, scale);}
+    else{
+        fprintf(stderr, "unknown shape '%s'\n", shape.c_str());
+        return 2;
+    }
+    printf("%ld\n", entries);
+    return 0;
+}
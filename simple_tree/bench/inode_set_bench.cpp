@@ -0,0 +1,31 @@
+// Micro-benchmark of InodeSet (--hardlinks) for run_bench.sh: inserts
+// random inode numbers on one device and prints one JSON result per power
+// of ten from 10^6 up to max_inodes, with the table's memory per tracked
+// inode at that point and the average insert time so far.
+//
+//   inode_set_bench [max_inodes]
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <chrono>
+#include "../inode_set.h"
+
+int main(int argc, char** argv){
+    size_t max_inodes = argc > 1 ? atol(argv[1]) : 10000000;
+    std::mt19937_64 rng(42);
+    InodeSet set;
+    size_t inserted = 0, next_report = 1000000;
+    auto t0 = std::chrono::steady_clock::now();
+    while(inserted < max_inodes){
+        if(set.insert(2049, rng() & ((1ULL << 40) - 1))){++inserted;}
+        if(inserted == next_report || inserted == max_inodes){
+            double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            printf("{\"bench\":\"inode_set\",\"inodes\":%zu,\"memory_bytes\":%zu,\"bytes_per_inode\":%.2f,"
+                   "\"insert_ns\":%.1f}\n",
+                   set.size(), set.memory_bytes(), (double)set.memory_bytes() / set.size(), s * 1e9 / inserted);
+            if(inserted == max_inodes){break;}
+            next_report *= 10;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Micro-benchmark of reading one large directory, for run_bench.sh: the
+// getdents64-based DirReader that scan_directory uses, against opendir +
+// readdir and against collecting std::filesystem::directory_entry objects
+// (what simple_tree did before DirReader). Prints one JSON result per
+// reader with the median time; the page cache is warmed first.
+//
+//   readdir_bench <dir> [repeat]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../dir_reader.h"
+
+namespace fs = std::filesystem;
+
+// Each reader returns the number of entries it saw (-1 on error).
+long read_dir_reader(const char* dir){
+    static std::vector<char> buf;
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd == -1){return -1;}
+    DirReader reader(fd, buf);
+    const char* name;
+    size_t name_len;
+    unsigned char dtype;
+    uint64_t ino;
+    long n = 0;
+    while(reader.next(name, name_len, dtype, ino)){++n;}
+    close(fd);
+    return reader.error() ? -1 : n;
+}
+
+long read_readdir(const char* dir){
+    DIR* d = opendir(dir);
+    if(!d){return -1;}
+    long n = 0;
+    while(struct dirent* e = readdir(d)){
+        const char* name = e->d_name;
+        if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))){continue;}
+        ++n;
+    }
+    closedir(d);
+    return n;
+}
+
+long read_filesystem(const char* dir){
+    std::error_code ec;
+    std::vector<fs::directory_entry> entries;
+    for(auto it = fs::directory_iterator(dir, ec); !ec && it != fs::directory_iterator(); it.increment(ec)){
+        entries.push_back(*it);
+    }
+    return ec ? -1 : (long)entries.size();
+}
+
+int main(int argc, char** argv){
+    if(argc < 2){
+        fprintf(stderr, "usage: %s <dir> [repeat]\n", argv[0]);
+        return 2;
+    }
+    const char* dir = argv[1];
+    int repeat = argc > 2 ? std::max(1, atoi(argv[2])) : 3;
+    struct Reader{
+        const char* name;
+        long (*read)(const char*);
+    } readers[] = {
+        {"getdents64", read_dir_reader}, {"readdir", read_readdir}, {"std_filesystem", read_filesystem}
+    };
+    read_dir_reader(dir);
+    for(auto& r : readers){
+        std::vector<double> t;
+        long n = 0;
+        for(int i=0;i<repeat;++i){
+            auto t0 = std::chrono::steady_clock::now();
+            n = r.read(dir);
+            t.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+        }
+        if(n < 0){
+            perror(dir);
+            return 1;
+        }
+        std::sort(t.begin(), t.end());
+        double s = t[t.size() / 2];
+        printf("{\"bench\":\"readdir\",\"reader\":\"%s\",\"entries\":%ld,\"runs\":%d,"
+               "\"wall_s\":%.6f,\"entries_per_sec\":%.0f}\n",
+               r.name, n, repeat, s, s > 0 ? n / s : 0);
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#!/bin/bash
+# Benchmarks simple_tree on generated trees and writes one JSON result per
+# (filesystem, shape, mode) line to the results file (default
+# bench_results.json), e.g. for diffing against a previous run. Output goes
+# through a pipe; the output-bound modes in null_modes are also run with
+# stdout on /dev/null ("stdout" in each result tells which). On the wide
+# shape, readdir_bench also compares getdents64 (DirReader) with readdir()
+# and std::filesystem on the one big directory. The sort_bench
+# micro-benchmark (sort_entries() per --sort order on 10^6 names, times
+# BENCH_SCALE) and inode_set_bench (InodeSet bytes per tracked inode at
+# 10^6 and 10^7 inodes, times BENCH_SCALE) are appended at the end.
+#
+#   simple_tree/bench/run_bench.sh [results.json]
+#
+# Environment:
+#   BENCH_DIRS    where to build the trees; by default tmpfs (/dev/shm) and
+#                 the disk behind ${TMPDIR:-/var/tmp}. "delay:DIR" builds
+#                 them in DIR and lists them through delay_fs, a FUSE mount
+#                 that answers every request after BENCH_DELAY_US (needs
+#                 root), e.g. to compare --uring and -j with the default on
+#                 a high-latency filesystem
+#   BENCH_DELAY_US  per-request latency of delay: targets (default 200)
+#   BENCH_SHAPES  subset of: wide deep symlinks hardlinks tiny monorepo
+#   BENCH_MODES   subset of the mode names below (default: all)
+#   BENCH_SCALE   size multiplier for the generated trees (default 1)
+#   BENCH_REPEAT  timed runs per mode, the median is reported (default 3)
+#   BENCH_JOBS    worker count for the -j mode (default: nproc)
+#   CXX, CC       compilers
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+results=${1:-bench_results.json}
+dirs=${BENCH_DIRS:-"/dev/shm ${TMPDIR:-/var/tmp}"}
+shapes=${BENCH_SHAPES:-"wide deep symlinks hardlinks tiny monorepo"}
+scale=${BENCH_SCALE:-1}
+repeat=${BENCH_REPEAT:-3}
+jobs=${BENCH_JOBS:-$(nproc)}
+delay_us=${BENCH_DELAY_US:-200}
+
+build=$(mktemp -d)
+mnt=
+trap '[ -n "$mnt" ] && umount "$mnt"; rm -rf "$build"' EXIT
+${CXX:-g++} -std=c++17 -O2 -pthread "$here/../main.cpp" -o "$build/simple_tree"
+${CXX:-g++} -std=c++17 -O2 "$here/gen_tree.cpp" -o "$build/gen_tree"
+${CXX:-g++} -std=c++17 -O2 "$here/bench_run.cpp" -o "$build/bench_run"
+${CXX:-g++} -std=c++17 -O2 "$here/sort_bench.cpp" -o "$build/sort_bench"
+${CXX:-g++} -std=c++17 -O2 "$here/readdir_bench.cpp" -o "$build/readdir_bench"
+${CXX:-g++} -std=c++17 -O2 "$here/inode_set_bench.cpp" -o "$build/inode_set_bench"
+${CXX:-g++} -std=c++17 -O2 -pthread "$here/delay_fs.cpp" -o "$build/delay_fs"
+${CC:-cc} -O2 -shared -fPIC "$here/count_shim.c" -o "$build/count_shim.so" -ldl
+
+modes=(
+    "default:"
+    "fast:--fast"
+    "parallel:-j$jobs"
+    "uring:--uring"
+    "unsorted:-U"
+    "sort_size:--sort=size"
+    "sort_mtime:--sort=mtime"
+    "sort_version:--sort=version"
+    "reverse:-r"
+    "ndjson:--format=ndjson"
+    "hardlinks:--hardlinks"
+    "gitignore:--gitignore"
+    # one metadata column each, then all of them (compare with default)
+    "col_perms:-p"
+    "col_user:-u"
+    "col_group:-g"
+    "col_size:-s"
+    "col_date:-D"
+    "col_all:-pugsD"
+)
+null_modes="default fast ndjson"
+
+: > "$results"
+for base in $dirs; do
+    delayed=
+    case $base in delay:*) delayed=1; base=${base#delay:};; esac
+    [ -d "$base" ] || continue
+    fs=$(stat -f -c %T "$base")
+    [ -n "$delayed" ] && fs="delay_fs_${delay_us}us"
+    for shape in $shapes; do
+        tree="$base/simple_tree_bench.$$/$shape"
+        mkdir -p "$(dirname "$tree")"
+        echo "generating $shape on $fs ($base)" >&2
+        if ! entries=$("$build/gen_tree" "$shape" "$tree" "$scale"); then
+            echo "skipping $shape on $fs: could not generate the tree" >&2
+            rm -rf "$base/simple_tree_bench.$$"
+            continue
+        fi
+        target=$tree
+        if [ -n "$delayed" ]; then
+            mnt="$base/simple_tree_bench.$$/mnt"
+            mkdir -p "$mnt"
+            if ! "$build/delay_fs" "$tree" "$mnt" "$delay_us"; then
+                echo "skipping $shape on $fs: could not mount delay_fs" >&2
+                mnt=
+                rm -rf "$base/simple_tree_bench.$$"
+                continue
+            fi
+            target=$mnt
+        fi
+        for m in "${modes[@]}"; do
+            name=${m%%:*}
+            args=${m#*:}
+            if [ -n "$BENCH_MODES" ] && [[ " $BENCH_MODES " != *" $name "* ]]; then continue; fi
+            label="\"fs\":\"$fs\",\"shape\":\"$shape\",\"mode\":\"$name\""
+            for sink in pipe null; do
+                if [ "$sink" = null ] && [[ " $null_modes " != *" $name "* ]]; then continue; fi
+                "$build/bench_run" "$build/count_shim.so" "$entries" "$repeat" "$label" --stdout=$sink -- \
+                    "$build/simple_tree" $args "$target" | tee -a "$results"
+            done
+        done
+        if [ "$shape" = wide ]; then
+            "$build/readdir_bench" "$target" "$repeat" | sed "s/^{/{\"fs\":\"$fs\",/" | tee -a "$results"
+        fi
+        if [ -n "$mnt" ]; then
+            umount "$mnt"
+            mnt=
+        fi
+        rm -rf "$base/simple_tree_bench.$$"
+    done
+done
+echo "running sort_bench" >&2
+"$build/sort_bench" $((1000000 * scale)) "$repeat" | tee -a "$results"
+echo "running inode_set_bench" >&2
+"$build/inode_set_bench" $((10000000 * scale)) | tee -a "$results"
+echo "results written to $results" >&2
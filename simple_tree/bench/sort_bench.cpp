@@ -0,0 +1,76 @@
+// Micro-benchmark of sort_entries() for run_bench.sh. Sorts synthetic
+// listings with every --sort order, plus the plain std::sort + strcmp over
+// the records that the prefix/radix name sort replaced, and prints one JSON
+// result per (names, order) with the median time.
+//
+//   sort_bench [entries] [repeat]
+//
+// names: hex8  random 8-char hex names (prefixes differ early)
+//        file  "file%07u.txt" in random order (long shared prefix)
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <dirent.h>
+#include "../entry_table.h"
+#include "../entry_sort.h"
+
+EntryTable make_listing(const char* style, size_t n){
+    std::mt19937_64 rng(42);
+    std::vector<uint32_t> ids(n);
+    for(size_t i=0;i<n;++i){ids[i] = i;}
+    std::shuffle(ids.begin(), ids.end(), rng);
+    EntryTable tbl;
+    char name[32];
+    for(size_t i=0;i<n;++i){
+        int len;
+        if(strcmp(style, "hex8") == 0){len = snprintf(name, sizeof(name), "%08x", (uint32_t)rng());}
+        else{len = snprintf(name, sizeof(name), "file%07u.txt", ids[i]);}
+        tbl.add(name, len, DT_REG, i + 1);
+        EntryRec& r = tbl[tbl.size() - 1];
+        r.size = rng() % (1 << 20);
+        r.mtime = 1700000000 + rng() % 100000000;
+        r.mtime_nsec = rng() % 1000000000;
+    }
+    return tbl;
+}
+
+// Seconds to sort a copy of src; order is a --sort name or "strcmp".
+double time_sort(const EntryTable& src, const char* order){
+    EntryTable tbl = src;
+    auto t0 = std::chrono::steady_clock::now();
+    if(strcmp(order, "strcmp") == 0){
+        const char* base = tbl.names();
+        std::sort(tbl.recs.begin(), tbl.recs.end(), [base](const EntryRec& a, const EntryRec& b){
+            return strcmp(base + a.name_off, base + b.name_off) < 0;
+        });
+    }
+    else{
+        SortOrder so = SortOrder::NAME;
+        parse_sort_order(order, so);
+        sort_entries(tbl, so, false);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char** argv){
+    size_t n = argc > 1 ? atol(argv[1]) : 1000000;
+    int repeat = argc > 2 ? std::max(1, atoi(argv[2])) : 3;
+    for(const char* style : {"hex8", "file"}){
+        EntryTable src = make_listing(style, n);
+        for(const char* order : {"strcmp", "name", "size", "mtime", "version"}){
+            std::vector<double> t;
+            for(int i=0;i<repeat;++i){t.push_back(time_sort(src, order));}
+            std::sort(t.begin(), t.end());
+            double s = t[t.size() / 2];
+            printf("{\"bench\":\"sort\",\"names\":\"%s\",\"order\":\"%s\",\"entries\":%zu,\"runs\":%d,"
+                   "\"wall_s\":%.6f,\"entries_per_sec\":%.0f}\n",
+                   style, order, n, repeat, s, s > 0 ? n / s : 0);
+        }
+    }
+    return 0;
+}
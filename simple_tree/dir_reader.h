@@ -0,0 +1,81 @@
+#ifndef DIR_READER_H
+#define DIR_READER_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "run_stats.h"
+
+// Layout the kernel fills in for getdents64(2); glibc does not export it
+// under a stable name.
+struct linux_dirent64{
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+/**
+ * Raw directory reader on top of getdents64(2). It reads from an fd the
+ * caller already opened into a caller-owned buffer (reused across
+ * directories), and hands out pointers straight into that buffer, so
+ * listing a directory does not allocate per entry. Name pointers stay
+ * valid until the next call to next().
+ */
+class DirReader{
+public:
+    static const size_t DEFAULT_BUFSIZE = 1 << 18;
+
+    DirReader(int dirfd, std::vector<char>& buffer, size_t bufsize = DEFAULT_BUFSIZE) : fd(dirfd), buf(buffer){
+        if(buf.size() < bufsize){buf.resize(bufsize);}
+    }
+
+    // Returns false at the end of the directory or on error (see error()).
+    // "." and ".." are skipped.
+    bool next(const char*& name, size_t& name_len, unsigned char& type, uint64_t& ino){
+        while(true){
+            if(pos >= len){
+                if(!fill()){return false;}
+            }
+            auto* d = reinterpret_cast<linux_dirent64*>(buf.data() + pos);
+            pos += d->d_reclen;
+            const char* n = d->d_name;
+            if(n[0] == '.' && (n[1] == '\0' || (n[1] == '.' && n[2] == '\0'))){continue;}
+            name = n;
+            name_len = strlen(n);
+            type = d->d_type;
+            ino  = d->d_ino;
+            return true;
+        }
+    }
+
+    int error() const{return err;}
+
+private:
+    int fd;
+    std::vector<char>& buf;
+    size_t pos = 0, len = 0;
+    int err = 0;
+
+    bool fill(){
+        long n;
+        do{
+            uint64_t t0 = stat_start();
+            n = syscall(SYS_getdents64, fd, buf.data(), buf.size());
+            stat_end(OP_GETDENTS, t0, n != -1);
+        }while(n == -1 && errno == EINTR);
+        if(n <= 0){
+            err = (n == -1 ? errno : 0);
+            return false;
+        }
+        pos = 0;
+        len = n;
+        return true;
+    }
+};
+
+#endif
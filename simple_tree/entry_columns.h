@@ -0,0 +1,242 @@
+#ifndef ENTRY_COLUMNS_H
+#define ENTRY_COLUMNS_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <pwd.h>
+#include <grp.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "entry_table.h"
+
+// -p -u -g -s -D: the metadata columns shown before each name, as in tree.
+enum ColumnFlag{
+    COL_PERMS = 1, COL_USER = 2, COL_GROUP = 4, COL_SIZE = 8, COL_DATE = 16
+};
+
+// "drwxr-xr-x" for mode; writes 10 chars.
+inline void format_mode(char* dst, uint32_t mode){
+    char type = '?';
+    if(S_ISREG(mode)){type = '-';}
+    else if(S_ISDIR(mode)){type = 'd';}
+    else if(S_ISLNK(mode)){type = 'l';}
+    else if(S_ISCHR(mode)){type = 'c';}
+    else if(S_ISBLK(mode)){type = 'b';}
+    else if(S_ISFIFO(mode)){type = 'p';}
+    else if(S_ISSOCK(mode)){type = 's';}
+    dst[0] = type;
+    const char* rwx = "rwxrwxrwx";
+    for(int i=0;i<9;++i){dst[1 + i] = (mode & (0400 >> i)) ? rwx[i] : '-';}
+    if(mode & S_ISUID){dst[3] = (mode & S_IXUSR) ? 's' : 'S';}
+    if(mode & S_ISGID){dst[6] = (mode & S_IXGRP) ? 's' : 'S';}
+    if(mode & S_ISVTX){dst[9] = (mode & S_IXOTH) ? 't' : 'T';}
+}
+
+/**
+ * uid or gid -> name, asking NSS (which may mean LDAP round trips) once per
+ * id. Ids without a name show as the number. Open addressing over a table
+ * that doubles at half full; a tree rarely has more than a handful of ids.
+ */
+class IdNames{
+public:
+    explicit IdNames(bool groups) : groups(groups), slots(16) {}
+
+    const std::string& name(uint32_t id){
+        size_t mask = slots.size() - 1;
+        for(size_t i=hash(id) & mask;;i=(i+1) & mask){
+            Slot& s = slots[i];
+            if(s.used && s.id == id){return s.name;}
+            if(!s.used){
+                if(++used * 2 > slots.size()){
+                    grow();
+                    --used;
+                    return name(id);
+                }
+                s.used = true;
+                s.id = id;
+                s.name = lookup(id);
+                return s.name;
+            }
+        }
+    }
+
+private:
+    struct Slot{
+        uint32_t id = 0;
+        bool used = false;
+        std::string name;
+    };
+    bool groups;
+    std::vector<Slot> slots;
+    size_t used = 0;
+
+    static size_t hash(uint32_t id){return id * 2654435761u;}
+
+    void grow(){
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for(auto& s : old){
+            if(!s.used){continue;}
+            size_t i = hash(s.id) & mask;
+            while(slots[i].used){i = (i + 1) & mask;}
+            slots[i] = std::move(s);
+        }
+    }
+
+    std::string lookup(uint32_t id) const{
+        long hint = sysconf(groups ? _SC_GETGR_R_SIZE_MAX : _SC_GETPW_R_SIZE_MAX);
+        std::vector<char> buf(hint > 0 ? hint : 1024);
+        while(true){
+            int err;
+            const char* found = nullptr;
+            if(groups){
+                struct group gr, *res = nullptr;
+                err = getgrgid_r(id, &gr, buf.data(), buf.size(), &res);
+                if(res){found = res->gr_name;}
+            }
+            else{
+                struct passwd pw, *res = nullptr;
+                err = getpwuid_r(id, &pw, buf.data(), buf.size(), &res);
+                if(res){found = res->pw_name;}
+            }
+            if(found){return found;}
+            if(err != ERANGE || buf.size() >= (1 << 20)){return std::to_string(id);}
+            buf.resize(buf.size() * 2);
+        }
+    }
+};
+
+/**
+ * -D dates in tree's C-locale layout: "Oct 17 12:00" within the last six
+ * months, "Oct 17  2025" otherwise (12 chars). The UTC offset is looked up
+ * with localtime_r once per hour of timestamps and cached; the calendar
+ * date is then computed arithmetically, so most lines cost no libc call.
+ */
+class DateFormatter{
+public:
+    explicit DateFormatter(int64_t now) : now(now) {}
+
+    size_t format(char* dst, int64_t t){
+        static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+        int64_t local = t + utc_offset(t);
+        int64_t days = floor_div(local, 86400), secs = local - days * 86400;
+        int64_t year;
+        int month, mday;
+        civil_from_days(days, year, month, mday);
+        memcpy(dst, months + (month - 1) * 3, 3);
+        dst[3] = ' ';
+        dst[4] = mday >= 10 ? '0' + mday / 10 : ' ';
+        dst[5] = '0' + mday % 10;
+        dst[6] = ' ';
+        if(t > now || t < now - SIX_MONTHS){
+            if(year < 0 || year > 9999){
+                return 7 + snprintf(dst + 7, 16, "%5lld", (long long)year);
+            }
+            dst[7] = ' ';
+            for(int i=11;i>=8;--i,year/=10){dst[i] = '0' + year % 10;}
+        }
+        else{
+            int hour = secs / 3600, min = secs / 60 % 60;
+            dst[7] = '0' + hour / 10; dst[8] = '0' + hour % 10;
+            dst[9] = ':';
+            dst[10] = '0' + min / 10; dst[11] = '0' + min % 10;
+        }
+        return 12;
+    }
+
+private:
+    static const int64_t SIX_MONTHS = 6 * 31 * 24 * 3600LL;
+    struct Hour{
+        int64_t hour = INT64_MIN;
+        long offset = 0;
+    };
+    int64_t now;
+    Hour hours[64];
+
+    static int64_t floor_div(int64_t a, int64_t b){return a / b - (a % b < 0);}
+
+    // Zones change offset on the hour, so one localtime_r per hour of
+    // timestamps is enough.
+    long utc_offset(int64_t t){
+        int64_t hour = floor_div(t, 3600);
+        Hour& h = hours[hour & 63];
+        if(h.hour != hour){
+            time_t start = hour * 3600;
+            struct tm tm;
+            h.hour = hour;
+            h.offset = localtime_r(&start, &tm) ? tm.tm_gmtoff : 0;
+        }
+        return h.offset;
+    }
+
+    // Days since 1970-01-01 -> proleptic Gregorian date.
+    static void civil_from_days(int64_t z, int64_t& y, int& m, int& d){
+        z += 719468;
+        int64_t era = floor_div(z, 146097);
+        int64_t doe = z - era * 146097;
+        int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int64_t mp = (5 * doy + 2) / 153;
+        d = doy - (153 * mp + 2) / 5 + 1;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        y = yoe + era * 400 + (m <= 2);
+    }
+};
+
+/**
+ * Renders the columns (ColumnFlag bits) of one entry into dst, which must
+ * hold 128 bytes: "[drwxr-xr-x root     root            4096 Oct 17 12:00]  ".
+ */
+class ColumnRenderer{
+public:
+    ColumnRenderer() : users(false), groups(true), dates(time(nullptr)) {}
+
+    size_t render(char* dst, const EntryRec& r, int columns){
+        char* p = dst;
+        *p++ = '[';
+        if(columns & COL_PERMS){
+            format_mode(p, r.mode);
+            p += 10;
+        }
+        if(columns & COL_USER){p = put_name(p, users.name(r.uid));}
+        if(columns & COL_GROUP){p = put_name(p, groups.name(r.gid));}
+        if(columns & COL_SIZE){
+            if(p[-1] != '['){*p++ = ' ';}
+            char digits[24];
+            int n = 0;
+            uint64_t v = r.size < 0 ? 0 : r.size;
+            do{digits[n++] = '0' + v % 10; v /= 10;}while(v);
+            for(int i=n;i<11;++i){*p++ = ' ';}
+            while(n){*p++ = digits[--n];}
+        }
+        if(columns & COL_DATE){
+            if(p[-1] != '['){*p++ = ' ';}
+            p += dates.format(p, r.mtime);
+        }
+        memcpy(p, "]  ", 3);
+        return p + 3 - dst;
+    }
+
+private:
+    IdNames users, groups;
+    DateFormatter dates;
+
+    // Names are padded to 8 and cut at 32, like tree's "%-8.32s".
+    char* put_name(char* p, const std::string& name){
+        if(p[-1] != '['){*p++ = ' ';}
+        size_t n = std::min<size_t>(name.size(), 32);
+        memcpy(p, name.data(), n);
+        p += n;
+        for(;n<8;++n){*p++ = ' ';}
+        return p;
+    }
+};
+
+#endif
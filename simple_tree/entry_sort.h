@@ -0,0 +1,138 @@
+#ifndef ENTRY_SORT_H
+#define ENTRY_SORT_H
+
+#include <cstdint>
+#include <cstring>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "entry_table.h"
+
+enum class SortOrder{
+    NAME,    // byte order of the name (default)
+    SIZE,    // largest first, then name
+    MTIME,   // newest first, then name
+    VERSION  // natural order: "file9" before "file10" (strverscmp)
+};
+
+// Sort key for one record. Names are compared through an 8-byte big-endian
+// prefix first, so most comparisons are a single integer compare; the rest
+// of the name is only looked at when the prefixes tie.
+struct SortKey{
+    uint64_t primary;   // order-specific key, 0 when sorting by name
+    uint64_t prefix;
+    uint32_t secondary; // tie-break within primary (--sort=mtime: nanoseconds)
+    uint32_t name_off, idx;
+};
+
+// Maps a signed value onto uint64_t keeping its order (pre-1970 mtimes and
+// the like are negative).
+inline uint64_t ordered_key(int64_t v){return (uint64_t)v ^ (1ULL << 63);}
+
+inline uint64_t name_prefix(const char* name, size_t len){
+    unsigned char b[8] = {0};
+    memcpy(b, name, len < 8 ? len : 8);
+    uint64_t v = 0;
+    for(int i=0;i<8;++i){v = (v << 8) | b[i];}
+    return v;
+}
+
+// Equal prefixes mean the first 8 bytes match, and since names contain no
+// NUL both names are then at least 8 bytes long (or identical).
+inline bool name_key_less(const char* base, const SortKey& a, const SortKey& b){
+    if(a.prefix != b.prefix){return a.prefix < b.prefix;}
+    return strcmp(base + a.name_off + 8, base + b.name_off + 8) < 0;
+}
+
+/**
+ * LSD radix sort on the 64-bit name prefixes, one byte per pass. Passes in
+ * which every key has the same byte (common: shared prefixes such as
+ * "lib" or "f000") are skipped. Runs of equal prefixes are then finished
+ * with a comparison sort on the rest of the name.
+ */
+inline void radix_sort_names(const char* base, std::vector<SortKey>& keys){
+    size_t n = keys.size();
+    std::vector<SortKey> tmp(n);
+    for(int shift=0;shift<64;shift+=8){
+        size_t count[257] = {0};
+        for(auto& k : keys){++count[((k.prefix >> shift) & 0xff) + 1];}
+        if(count[((keys[0].prefix >> shift) & 0xff) + 1] == n){continue;}
+        for(int d=0;d<256;++d){count[d+1] += count[d];}
+        for(auto& k : keys){tmp[count[(k.prefix >> shift) & 0xff]++] = k;}
+        keys.swap(tmp);
+    }
+    for(size_t i=0;i<n;){
+        size_t j = i + 1;
+        while(j < n && keys[j].prefix == keys[i].prefix){++j;}
+        if(j - i > 1){
+            std::sort(keys.begin() + i, keys.begin() + j, [base](const SortKey& a, const SortKey& b){
+                return strcmp(base + a.name_off + 8, base + b.name_off + 8) < 0;
+            });
+        }
+        i = j;
+    }
+}
+
+// Reorders tbl's records according to order (reversed if asked).
+inline void sort_entries(EntryTable& tbl, SortOrder order, bool reverse){
+    size_t n = tbl.size();
+    if(n < 2){return;}
+    std::vector<SortKey> keys(n);
+    for(uint32_t i=0;i<n;++i){
+        const EntryRec& r = tbl[i];
+        uint64_t primary = 0;
+        uint32_t secondary = 0;
+        // Descending orders are stored complemented so every key sorts ascending.
+        if(order == SortOrder::SIZE){primary = ~ordered_key(r.size);}
+        else if(order == SortOrder::MTIME){
+            primary = ~ordered_key(r.mtime);
+            secondary = ~r.mtime_nsec;
+        }
+        keys[i] = {primary, name_prefix(tbl.name(r), r.name_len), secondary, r.name_off, i};
+    }
+
+    const char* base = tbl.names();
+    if(order == SortOrder::VERSION){
+        std::sort(keys.begin(), keys.end(), [base](const SortKey& a, const SortKey& b){
+            return strverscmp(base + a.name_off, base + b.name_off) < 0;
+        });
+    }
+    else if(order == SortOrder::NAME && n >= 256){radix_sort_names(base, keys);}
+    else{
+        std::sort(keys.begin(), keys.end(), [base](const SortKey& a, const SortKey& b){
+            if(a.primary != b.primary){return a.primary < b.primary;}
+            if(a.secondary != b.secondary){return a.secondary < b.secondary;}
+            return name_key_less(base, a, b);
+        });
+    }
+    if(reverse){std::reverse(keys.begin(), keys.end());}
+
+    std::vector<uint32_t> perm(n);
+    for(size_t i=0;i<n;++i){perm[i] = keys[i].idx;}
+    tbl.permute(perm);
+}
+
+// The order sort_entries() produces, for two records of possibly different
+// tables (used when merging separately sorted runs). Must agree with its
+// keys exactly, or merged runs come out unsorted.
+inline bool entry_before(const EntryTable& ta, const EntryRec& a, const EntryTable& tb, const EntryRec& b,
+                         SortOrder order, bool reverse){
+    if(reverse){return entry_before(tb, b, ta, a, order, false);}
+    if(order == SortOrder::VERSION){return strverscmp(ta.name(a), tb.name(b)) < 0;}
+    if(order == SortOrder::SIZE && a.size != b.size){return a.size > b.size;}
+    if(order == SortOrder::MTIME && (a.mtime != b.mtime || a.mtime_nsec != b.mtime_nsec)){
+        return a.mtime != b.mtime ? a.mtime > b.mtime : a.mtime_nsec > b.mtime_nsec;
+    }
+    return strcmp(ta.name(a), tb.name(b)) < 0;
+}
+
+inline bool parse_sort_order(const char* s, SortOrder& order){
+    if(strcmp(s, "name") == 0){order = SortOrder::NAME;}
+    else if(strcmp(s, "size") == 0){order = SortOrder::SIZE;}
+    else if(strcmp(s, "mtime") == 0){order = SortOrder::MTIME;}
+    else if(strcmp(s, "version") == 0){order = SortOrder::VERSION;}
+    else{return false;}
+    return true;
+}
+
+#endif
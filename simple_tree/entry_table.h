@@ -0,0 +1,149 @@
+#ifndef ENTRY_TABLE_H
+#define ENTRY_TABLE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+
+// Fixed-size per-entry record. Names and symlink targets live in the
+// owning EntryTable's arena and are referenced by offset.
+struct EntryRec{
+    uint32_t name_off, name_len;
+    uint32_t link_off, link_len;  // symlink target text, link_len 0 if none
+    uint32_t mode;                // st_mode of the entry itself (lstat)
+    uint32_t target_mode;         // st_mode through a symlink, 0 if dangling
+    uint32_t nlink, uid, gid;
+    uint8_t  dtype;               // d_type from getdents64
+    uint8_t  has_stat;            // 0 if only mode/ino are known (from d_type)
+    uint64_t ino, dev;
+    int64_t  size, blocks;
+    int64_t  mtime, ctime;
+    uint32_t mtime_nsec, ctime_nsec;
+};
+
+/**
+ * Compact listing of one directory: an array of EntryRec plus a single
+ * arena holding every name (NUL-terminated, so they can be passed straight
+ * to *at() syscalls). Appending to the arena may move it, so name pointers
+ * are only valid until the next add()/set_link().
+ */
+class EntryTable{
+public:
+    std::vector<EntryRec> recs;
+
+    size_t size() const{return recs.size();}
+    EntryRec& operator[](size_t i){return recs[i];}
+    const EntryRec& operator[](size_t i) const{return recs[i];}
+
+    const char* names() const{return arena.data();}
+    size_t names_size() const{return arena.size();}
+    const char* name(const EntryRec& r) const{return arena.data() + r.name_off;}
+    const char* link(const EntryRec& r) const{return arena.data() + r.link_off;}
+    std::string name_str(const EntryRec& r) const{return std::string(name(r), r.name_len);}
+
+    void add(const char* n, size_t len, unsigned char dtype, uint64_t ino){
+        EntryRec r;
+        memset(&r, 0, sizeof(r));
+        r.name_off = put(n, len);
+        r.name_len = len;
+        r.dtype = dtype;
+        r.ino = ino;
+        recs.push_back(r);
+    }
+
+    // Replaces the contents with n records and their arena, e.g. from an index.
+    void load(const EntryRec* r, size_t n, const char* names, size_t names_len){
+        recs.assign(r, r + n);
+        arena.assign(names, names + names_len);
+    }
+
+    void set_link(EntryRec& r, const char* target, size_t len){
+        r.link_off = put(target, len);
+        r.link_len = len;
+    }
+
+    void set_stat(EntryRec& r, const struct stat& st){
+        r.mode   = st.st_mode;
+        r.nlink  = st.st_nlink;
+        r.uid    = st.st_uid;
+        r.gid    = st.st_gid;
+        r.ino    = st.st_ino;
+        r.dev    = st.st_dev;
+        r.size   = st.st_size;
+        r.blocks = st.st_blocks;
+        r.mtime  = st.st_mtim.tv_sec;
+        r.mtime_nsec = st.st_mtim.tv_nsec;
+        r.ctime  = st.st_ctim.tv_sec;
+        r.ctime_nsec = st.st_ctim.tv_nsec;
+        r.has_stat = 1;
+    }
+
+    // Drops records with mode 0 (entries that vanished before they could be
+    // stat()ed). Their names stay in the arena until the table goes away.
+    void remove_unstated(){
+        remove_if([](const EntryRec& r){return r.mode == 0;});
+    }
+
+    // Drops every record pred(rec) holds for, keeping the order of the rest.
+    template<class Pred>
+    void remove_if(Pred pred){
+        recs.erase(std::remove_if(recs.begin(), recs.end(), pred), recs.end());
+    }
+
+    void remove(size_t i){recs.erase(recs.begin() + i);}
+
+    // Appends a copy of r (a record of other), with its name and link text.
+    void append_from(const EntryTable& other, const EntryRec& r){
+        append(r, other.name(r), other.link(r));
+    }
+
+    // Appends r with its name and link text taken from the given buffers.
+    void append(const EntryRec& r, const char* name, const char* link){
+        EntryRec copy = r;
+        copy.name_off = put(name, r.name_len);
+        copy.link_off = 0;
+        if(r.link_len){copy.link_off = put(link, r.link_len);}
+        recs.push_back(copy);
+    }
+
+    void clear(){
+        recs.clear();
+        arena.clear();
+    }
+
+    // Bytes held by the records and the arena.
+    size_t memory_bytes() const{return recs.size() * sizeof(EntryRec) + arena.size();}
+
+    // Makes recs[i] = old recs[order[i]], following the permutation's cycles
+    // so no second copy of the records is needed. Consumes order.
+    void permute(std::vector<uint32_t>& order){
+        for(uint32_t i=0;i<order.size();++i){
+            if(order[i] == i){continue;}
+            EntryRec tmp = recs[i];
+            uint32_t j = i;
+            while(order[j] != i){
+                recs[j] = recs[order[j]];
+                uint32_t next = order[j];
+                order[j] = j;
+                j = next;
+            }
+            recs[j] = tmp;
+            order[j] = j;
+        }
+    }
+
+private:
+    std::vector<char> arena;
+
+    uint32_t put(const char* s, size_t len){
+        uint32_t off = arena.size();
+        arena.insert(arena.end(), s, s + len);
+        arena.push_back('\0');
+        return off;
+    }
+};
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef IGNORE_RULES_H
+#define IGNORE_RULES_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+// gitignore-style glob match: '*' and '?' stop at '/', "**/" matches any
+// number of whole directories, any other "**" matches across '/'.
+inline bool wild_match(const char* p, const char* s){
+    for(; *p; ++p, ++s){
+        if(*p == '*'){
+            if(p[1] == '*'){
+                const char* rest = p + 2;
+                if(*rest == '/'){
+                    ++rest;
+                    for(const char* t=s;;++t){
+                        if((t == s || t[-1] == '/') && wild_match(rest, t)){return true;}
+                        if(!*t){return false;}
+                    }
+                }
+                for(const char* t=s;;++t){
+                    if(wild_match(rest, t)){return true;}
+                    if(!*t){return false;}
+                }
+            }
+            for(const char* t=s;;++t){
+                if(wild_match(p + 1, t)){return true;}
+                if(!*t || *t == '/'){return false;}
+            }
+        }
+        if(!*s){return false;}
+        if(*p == '?'){
+            if(*s == '/'){return false;}
+            continue;
+        }
+        if(*p == '['){
+            const char* q = p + 1;
+            bool negate = (*q == '!' || *q == '^');
+            if(negate){++q;}
+            bool hit = false;
+            for(bool first=true; *q && (first || *q != ']'); first=false){
+                char lo = *q++, hi = lo;
+                if(*q == '-' && q[1] && q[1] != ']'){hi = q[1]; q += 2;}
+                if((unsigned char)*s >= (unsigned char)lo && (unsigned char)*s <= (unsigned char)hi){hit = true;}
+            }
+            if(*q != ']'){ // unterminated: a literal '['
+                if(*s != '['){return false;}
+                continue;
+            }
+            if(*s == '/' || hit == negate){return false;}
+            p = q;
+            continue;
+        }
+        if(*p == '\\' && p[1]){++p;}
+        if(*p != *s){return false;}
+    }
+    return !*s;
+}
+
+/**
+ * The rules of one .gitignore/.ignore file, compiled for matching whole
+ * directory listings. Rules on bare names are indexed: exact names in a
+ * hash map, "*.ext" rules by extension, so a typical entry costs one or two
+ * lookups; only the remaining globs are tried one by one. Rules containing
+ * a '/' match the path relative to the file's directory. As in git the
+ * last matching rule wins, so every lookup returns the highest rule number.
+ */
+class IgnoreRules{
+public:
+    // Adds the rules in text (the contents of one ignore file).
+    void parse(const char* text, size_t len){
+        const char* end = text + len;
+        for(const char* p=text;p<end;){
+            const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+            if(!nl){nl = end;}
+            add_line(std::string(p, nl - p));
+            p = nl + 1;
+        }
+    }
+
+    bool empty() const{return rules.empty();}
+
+    // Number of the last rule matching the entry, or -1. rel_path() is only
+    // called for rules with a '/' and must return the entry's path relative
+    // to the directory holding the ignore file.
+    template<class RelPath>
+    int match(const char* name, size_t len, bool is_dir, RelPath rel_path) const{
+        int best = -1;
+        if(!literals.empty()){
+            auto it = literals.find(std::string(name, len));
+            if(it != literals.end()){best = last_of(it->second, is_dir, best);}
+        }
+        if(!extensions.empty()){
+            const char* dot = static_cast<const char*>(memrchr(name, '.', len));
+            if(dot){
+                auto it = extensions.find(std::string(dot + 1, name + len - dot - 1));
+                if(it != extensions.end()){
+                    for(auto k=it->second.rbegin();k!=it->second.rend() && (int)*k>best;++k){
+                        const std::string& suf = rules[*k].pattern; // "*.tar.gz" -> ".tar.gz"
+                        size_t n = suf.size() - 1;
+                        if(len >= n && memcmp(name + len - n, suf.data() + 1, n) == 0
+                           && (is_dir || !rules[*k].dir_only)){
+                            best = *k;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        for(auto k=name_globs.rbegin();k!=name_globs.rend() && (int)*k>best;++k){
+            if((is_dir || !rules[*k].dir_only) && wild_match(rules[*k].pattern.c_str(), name)){
+                best = *k;
+                break;
+            }
+        }
+        if(!path_globs.empty() && (int)path_globs.back() > best){
+            std::string rel = rel_path();
+            for(auto k=path_globs.rbegin();k!=path_globs.rend() && (int)*k>best;++k){
+                if((is_dir || !rules[*k].dir_only) && wild_match(rules[*k].pattern.c_str(), rel.c_str())){
+                    best = *k;
+                    break;
+                }
+            }
+        }
+        return best;
+    }
+
+    bool negated(int rule) const{return rules[rule].negate;}
+
+private:
+    struct Rule{
+        std::string pattern;
+        bool negate, dir_only;
+    };
+
+    std::vector<Rule> rules;
+    // Rule numbers, ascending within each list.
+    std::unordered_map<std::string, std::vector<uint32_t>> literals, extensions;
+    std::vector<uint32_t> name_globs, path_globs;
+
+    static bool has_magic(const char* s){return strpbrk(s, "*?[\\") != nullptr;}
+
+    int last_of(const std::vector<uint32_t>& ids, bool is_dir, int best) const{
+        for(auto k=ids.rbegin();k!=ids.rend() && (int)*k>best;++k){
+            if(is_dir || !rules[*k].dir_only){return *k;}
+        }
+        return best;
+    }
+
+    void add_line(std::string line){
+        if(!line.empty() && line.back() == '\r'){line.pop_back();}
+        while(!line.empty() && line.back() == ' ' && !(line.size() > 1 && line[line.size()-2] == '\\')){
+            line.pop_back();
+        }
+        if(line.empty() || line[0] == '#'){return;}
+        Rule r{"", false, false};
+        size_t b = 0;
+        if(line[0] == '!'){r.negate = true; b = 1;}
+        else if(line[0] == '\\' && (line[1] == '#' || line[1] == '!')){b = 1;}
+        line.erase(0, b);
+        if(!line.empty() && line.back() == '/'){r.dir_only = true; line.pop_back();}
+        if(line.empty()){return;}
+
+        uint32_t id = rules.size();
+        bool anchored = line.find('/') != std::string::npos;
+        if(line[0] == '/'){line.erase(0, 1);}
+        r.pattern = line;
+        rules.push_back(r);
+        const char* pat = r.pattern.c_str();
+        if(anchored){path_globs.push_back(id);}
+        else if(!has_magic(pat)){literals[r.pattern].push_back(id);}
+        else if(pat[0] == '*' && pat[1] == '.' && !has_magic(pat + 1)){
+            extensions[r.pattern.substr(r.pattern.rfind('.') + 1)].push_back(id);
+        }
+        else{name_globs.push_back(id);}
+    }
+};
+
+// One level of the ignore stack: the rules found in a directory at the
+// given depth, on top of everything its ancestors loaded.
+struct IgnoreLevel{
+    IgnoreRules rules;
+    int depth;
+    std::shared_ptr<const IgnoreLevel> up;
+};
+
+#endif
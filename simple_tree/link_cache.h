@@ -0,0 +1,49 @@
+#ifndef LINK_CACHE_H
+#define LINK_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+
+/**
+ * What symlink targets resolve to (st_mode, 0 if dangling), remembered for
+ * the rest of the run so links sharing a target cost one readlinkat and no
+ * stat. A link is identified by its text plus, for relative targets, the
+ * directory it sits in (dev/ino), which is exactly what the kernel resolves
+ * it from. Each scanning thread keeps its own cache; it is dropped whole
+ * when it reaches MAX_ENTRIES.
+ */
+class LinkCache{
+public:
+    static const size_t MAX_ENTRIES = 1 << 20;
+
+    // Builds the key for target (len bytes) found in directory dir; dir may
+    // be null for absolute targets.
+    static void make_key(std::string& key, const struct stat* dir, const char* target, size_t len){
+        key.clear();
+        if(target[0] != '/'){
+            uint64_t id[2] = {(uint64_t)dir->st_dev, (uint64_t)dir->st_ino};
+            key.append(reinterpret_cast<const char*>(id), sizeof(id));
+        }
+        key.append(target, len);
+    }
+
+    bool find(const std::string& key, uint32_t& mode) const{
+        auto it = modes.find(key);
+        if(it == modes.end()){return false;}
+        mode = it->second;
+        return true;
+    }
+
+    void insert(const std::string& key, uint32_t mode){
+        if(modes.size() >= MAX_ENTRIES){modes.clear();}
+        modes.emplace(key, mode);
+    }
+
+private:
+    std::unordered_map<std::string, uint32_t> modes;
+};
+
+#endif
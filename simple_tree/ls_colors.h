@@ -0,0 +1,178 @@
+#ifndef LS_COLORS_H
+#define LS_COLORS_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <sys/stat.h>
+
+/**
+ * Entry colors, from LS_COLORS on top of simple_tree's own palette. Every
+ * escape sequence is rendered to bytes once, when LS_COLORS is parsed, so
+ * coloring an entry is a table lookup plus one append. "*.ext" rules go
+ * into a perfect hash: the seed and table size are searched at load time
+ * until every extension lands in its own slot, so a lookup is one hash and
+ * one compare. Other "*suffix" rules (e.g. "*.tar.gz", "*~") are few and
+ * are matched with memcmp first.
+ */
+class ColorTable{
+public:
+    enum Slot{
+        RESET, FILE, DIR, LINK, FIFO, SOCK, BLK, CHR, ORPHAN, MISSING,
+        EXEC, SETUID, SETGID, STICKY, OTHER_WRITABLE, STICKY_OTHER_WRITABLE,
+        SLOT_COUNT
+    };
+
+    ColorTable(){
+        // The palette simple_tree has always used; no color for plain files.
+        set(RESET, "0");
+        set(DIR, "36");
+        set(LINK, "32");
+        set(CHR, "35");
+        set(BLK, "31");
+        set(FIFO, "34");
+        set(SOCK, "33");
+    }
+
+    // Applies an LS_COLORS string ("di=01;34:ln=target:*.tar=01;31:...").
+    // Unknown keys are ignored, as ls does.
+    void parse(const char* spec){
+        static const char* const keys[SLOT_COUNT] = {
+            "rs", "fi", "di", "ln", "pi", "so", "bd", "cd", "or", "mi",
+            "ex", "su", "sg", "st", "ow", "tw"
+        };
+        std::vector<std::pair<std::string, std::string>> exts;
+        const char* p = spec;
+        while(*p){
+            const char* end = strchr(p, ':');
+            if(!end){end = p + strlen(p);}
+            const char* eq = static_cast<const char*>(memchr(p, '=', end - p));
+            if(eq){
+                std::string key(p, eq - p), val(eq + 1, end - eq - 1);
+                if(key.size() > 1 && key[0] == '*'){
+                    std::string suffix = key.substr(1);
+                    size_t dot = suffix.rfind('.');
+                    if(dot == 0 && suffix.size() > 1){exts.emplace_back(suffix.substr(1), val);}
+                    else{suffixes.emplace_back(suffix, render(val));}
+                }
+                else if(key == "ln" && val == "target"){link_as_target = true;}
+                else{
+                    for(int s=0;s<SLOT_COUNT;++s){
+                        if(key == keys[s]){set((Slot)s, val); break;}
+                    }
+                }
+            }
+            p = *end ? end + 1 : end;
+        }
+        build_ext_table(exts);
+    }
+
+    const std::string& reset() const{return esc[RESET];}
+
+    // Escape for an entry named name (len bytes) with st_mode mode, or null
+    // if it keeps the current color. target_mode is only used for symlinks:
+    // 0 means dangling.
+    const std::string* for_entry(uint32_t mode, uint32_t target_mode, const char* name, size_t len) const{
+        Slot s;
+        if(S_ISREG(mode)){
+            if((mode & S_ISUID) && !esc[SETUID].empty()){s = SETUID;}
+            else if((mode & S_ISGID) && !esc[SETGID].empty()){s = SETGID;}
+            else if((mode & 0111) && !esc[EXEC].empty()){s = EXEC;}
+            else{
+                if(const std::string* e = by_name(name, len)){return e;}
+                s = FILE;
+            }
+        }
+        else if(S_ISDIR(mode)){
+            bool ow = mode & S_IWOTH, sticky = mode & S_ISVTX;
+            if(ow && sticky && !esc[STICKY_OTHER_WRITABLE].empty()){s = STICKY_OTHER_WRITABLE;}
+            else if(ow && !esc[OTHER_WRITABLE].empty()){s = OTHER_WRITABLE;}
+            else if(sticky && !esc[STICKY].empty()){s = STICKY;}
+            else{s = DIR;}
+        }
+        else if(S_ISLNK(mode)){
+            if(target_mode == 0 && !esc[ORPHAN].empty()){s = ORPHAN;}
+            else if(link_as_target && target_mode != 0){return for_entry(target_mode, 0, name, len);}
+            else{s = LINK;}
+        }
+        else if(S_ISFIFO(mode)){s = FIFO;}
+        else if(S_ISSOCK(mode)){s = SOCK;}
+        else if(S_ISCHR(mode)){s = CHR;}
+        else if(S_ISBLK(mode)){s = BLK;}
+        else if(mode == 0){s = MISSING;}
+        else{return nullptr;}
+        return esc[s].empty() ? nullptr : &esc[s];
+    }
+
+private:
+    std::string esc[SLOT_COUNT];
+    bool link_as_target = false;
+    std::vector<std::pair<std::string, std::string>> suffixes; // suffix, escape
+    // Perfect hash of extensions: slot -> index into ext_keys/ext_escs or -1.
+    std::vector<int32_t> ext_index;
+    std::vector<std::string> ext_keys, ext_escs;
+    uint32_t ext_seed = 0;
+
+    static std::string render(const std::string& code){return "\x1b[" + code + "m";}
+
+    void set(Slot s, const std::string& code){esc[s] = code.empty() ? "" : render(code);}
+
+    static uint32_t ext_hash(const char* s, size_t n, uint32_t seed){
+        uint32_t h = 2166136261u ^ seed;
+        for(size_t i=0;i<n;++i){h = (h ^ (unsigned char)s[i]) * 16777619u;}
+        return h ^ (h >> 15);
+    }
+
+    // Later rules override earlier ones for the same extension, as in ls.
+    void build_ext_table(const std::vector<std::pair<std::string, std::string>>& exts){
+        ext_keys.clear();
+        ext_escs.clear();
+        for(auto& e : exts){
+            size_t i = 0;
+            while(i < ext_keys.size() && ext_keys[i] != e.first){++i;}
+            if(i == ext_keys.size()){
+                ext_keys.push_back(e.first);
+                ext_escs.emplace_back();
+            }
+            ext_escs[i] = e.second.empty() ? "" : render(e.second);
+        }
+        ext_index.clear();
+        if(ext_keys.empty()){return;}
+        size_t size = 1;
+        while(size < ext_keys.size() * 2){size <<= 1;}
+        for(;; size <<= 1){
+            for(uint32_t seed=1;seed<=64;++seed){
+                ext_index.assign(size, -1);
+                bool ok = true;
+                for(size_t i=0;i<ext_keys.size() && ok;++i){
+                    int32_t& slot = ext_index[ext_hash(ext_keys[i].data(), ext_keys[i].size(), seed) & (size - 1)];
+                    if(slot != -1){ok = false;}
+                    slot = i;
+                }
+                if(ok){
+                    ext_seed = seed;
+                    return;
+                }
+            }
+        }
+    }
+
+    const std::string* by_name(const char* name, size_t len) const{
+        for(auto& s : suffixes){
+            size_t n = s.first.size();
+            if(len >= n && memcmp(name + len - n, s.first.data(), n) == 0){return &s.second;}
+        }
+        if(ext_index.empty()){return nullptr;}
+        const char* dot = static_cast<const char*>(memrchr(name, '.', len));
+        if(!dot){return nullptr;}
+        const char* ext = dot + 1;
+        size_t n = name + len - ext;
+        int32_t i = ext_index[ext_hash(ext, n, ext_seed) & (ext_index.size() - 1)];
+        if(i == -1 || ext_keys[i].size() != n || memcmp(ext_keys[i].data(), ext, n) != 0){return nullptr;}
+        return ext_escs[i].empty() ? nullptr : &ext_escs[i];
+    }
+};
+
+#endif
@@ -1,161 +1,1641 @@
-#include <iostream>
-#include <cstdio>
-#include <cstring>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <dirent.h>
-#include <errno.h>
-#include <unistd.h>
-#include <stack>
-#include <vector>
-#include <filesystem>
-#include <algorithm>
-
-typedef std::filesystem::directory_entry dir_entry;
-
-namespace fs = std::filesystem;
-const int MAX_TRAVERSE_DEPTH = 10;
-
-int reg_total = 0, dir_total = 0, blk_total = 0;
-
-enum class Color{
-    BLACK = 30, RED = 31, GREEN = 32, YELLOW = 33,
-    BLUE = 34, MAGENTA = 35, CYAN = 36, WHITE = 37,
-    RESET = 0
-};
-
-void change_color(Color clr){
-    printf("\u001b[%dm", (int)clr);
-}
-
-void change_color4mode(int fmode){
-    if(S_ISLNK(fmode)){change_color(Color::GREEN);}
-    else if(S_ISDIR(fmode)){++dir_total; change_color(Color::CYAN);}
-    else if(S_ISCHR(fmode)){change_color(Color::MAGENTA);}
-    else if(S_ISBLK(fmode)){change_color(Color::RED);}
-    else if(S_ISFIFO(fmode)){change_color(Color::BLUE);}
-    else if(S_ISSOCK(fmode)){change_color(Color::YELLOW);}
-}
-
-void change_color4mode(char* path){
-    if(fs::is_symlink(path)){change_color(Color::GREEN); return;}
-    struct stat fstat;
-    if(stat(path, &fstat) == -1){
-        std::cout << "Unable to get file stat for " << path << '\n';
-        std::cout << strerror(errno) << '\n';
-        return ;
-    }
-    change_color4mode(fstat.st_mode);
-}
-
-bool sort_by_name(dir_entry e1, dir_entry e2){
-    return e1.path() < e2.path();
-}
-
-std::string path2filename(char* path){
-    std::stack<char> _stack;
-    int len = strlen(path);
-    for(int i=len-1;i>=0;--i){
-        if(path[i] == '/' || path[i] == '\\'){break;}
-        _stack.push(path[i]);
-    }
-    std::string filename = "";
-    while(!_stack.empty()){
-        filename += _stack.top();
-        _stack.pop();
-    }
-    return filename;
-}
-
-void print_padding(int depth, std::vector<bool> padding){
-    for(int i=0;i<depth;++i){
-        std::cout << (padding[i] ? '|' : ' ') << "   ";
-    }
-}
-
-int print_filename(char* path){
-    struct stat fstat;
-    if(stat(path, &fstat) == -1){return -1;}
-    int fmode = fstat.st_mode;
-    std::cout << "+---";
-
-    if(S_ISDIR(fmode)){std::cout << "+ ";}
-    else{std::cout << "- ";}
-
-    if(S_ISREG(fmode)){++reg_total;}
-    blk_total += fstat.st_blocks;
-
-    change_color4mode(path);
-    std::cout << path2filename(path);
-    if(fs::is_symlink(path)){
-        std::cout << " -> ";
-        std::string dest = fs::read_symlink(path);
-        change_color4mode(const_cast<char*>(dest.c_str()));
-        std::cout << dest;
-    }
-    std::cout << '\n';
-    change_color(Color::RESET);
-    return fmode;
-}
-
-int list_directory(char* path, int depth, std::vector<bool> padding){
-    struct stat parent_stat;
-    DIR* cur_dir;
-
-    if(stat(path, &parent_stat) == -1){
-        std::cout << "Errnor while reading stat " << path << '\n';
-        return -1;
-    }
-    auto fmode = parent_stat.st_mode;
-    //std::cout << fmode << '\n';
-    //std::cout << S_ISDIR(fmode) << ' ' << S_ISREG(fmode) << ' ' << S_ISLNK(fmode) << '\n';
-    if(!(cur_dir = opendir(path))){
-        std::cout << "Unable to open " << path << " : " << strerror(errno) << '\n';
-        return -1;
-    }
-    else{
-        if(depth == 0){
-            change_color(Color::CYAN);
-            std::cout << path << '\n';
-            change_color(Color::RESET);
-        }
-        std::vector<dir_entry> flist;
-        for(auto &entry : fs::directory_iterator(path)){
-            flist.push_back(entry);
-        }
-        std::sort(flist.begin(), flist.end(), sort_by_name);
-        int len = flist.size();
-        for(int i=0;i<len;++i){
-            auto& entry = flist[i];
-            std::string str = entry.path();
-            print_padding(depth, padding);
-            int _sfmode = print_filename(const_cast<char*>(str.c_str()));
-            if(_sfmode == -1){return -1;}
-            else if(S_ISDIR(_sfmode) && !fs::is_symlink(str)){
-                auto _padding = padding;
-                _padding.push_back(i == len-1 ? false : true);
-                list_directory(const_cast<char*>(str.c_str()), depth+1, _padding);
-                print_padding(depth+1, _padding);
-                std::cout << '\n';
-            }
-        }
-        closedir(cur_dir);
-    }
-    change_color(Color::RESET);
-    return 0;
-}
-
-int main(int argc, char** argv){
-    for(int i=1;i<argc;++i){
-        std::vector<bool> padding;
-        change_color(Color::RESET);
-        reg_total = 0; dir_total = 0; blk_total = 0;
-        int ret = list_directory(argv[i], 0, padding);
-        if(ret == -1){std::cout << "\nAn Error occured!\n";}
-        std::cout << "*===============\n";
-        std::cout << "Total regular files: " << reg_total << '\n';
-        std::cout << "Total directories: " << dir_total << '\n';
-        std::cout << "Blocks used: " << blk_total << '\n';
-    }
-    return 0;
-}
+#include <cstdio>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <climits>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <csignal>
+#include <unordered_map>
+#include "dir_reader.h"
+#include "entry_table.h"
+#include "entry_sort.h"
+#include "out_buffer.h"
+#include "uring_stat.h"
+#include "tree_index.h"
+#include "inode_set.h"
+#include "name_filter.h"
+#include "ignore_rules.h"
+#include "record_format.h"
+#include "spill_sort.h"
+#include "run_stats.h"
+#include "link_cache.h"
+#include "ls_colors.h"
+#include "entry_columns.h"
+#include "top_heap.h"
+
+const int MAX_TRAVERSE_DEPTH = 10;
+
+// Totals and output are per root; roots on different devices are listed by
+// threads of their own (see list_roots), each writing to its own buffer.
+thread_local int64_t reg_total = 0, dir_total = 0, blk_total = 0;
+thread_local int64_t logical_bytes = 0, unique_bytes = 0; // --hardlinks only
+OutBuffer stdout_buf(STDOUT_FILENO);
+thread_local OutBuffer* out = &stdout_buf;
+int worker_cnt = 0; // 0 = scan inline while printing, >0 = `-j N` worker pool
+bool FLAG_FAST   = false; // --fast: classify entries by d_type, stat only when needed
+bool FLAG_BLOCKS = true;  // count st_blocks (always on unless --fast without --blocks)
+bool FLAG_URING  = false; // --uring: batch each listing's stats through io_uring
+bool FLAG_REVERSE = false; // -r: reverse the sort order
+bool FLAG_WATCH   = false; // --watch: keep the tree in memory and follow changes
+enum class DuMode{
+    NONE,
+    PRE,  // --du: annotate directory lines, each subtree is scanned before it is printed
+    POST, // --du=post: stream one du-style line per directory as it completes
+    TOP   // --top: print nothing but the largest files and directories at the end
+};
+DuMode du_mode = DuMode::NONE;
+size_t top_n = 0;        // --top=N: entries per list
+bool top_blocks = false; // --top-by=blocks: rank by st_blocks instead of size
+
+// --top: each thread keeps its own bounded heaps; they are merged at exit.
+struct TopHeaps{
+    TopHeap files, dirs;
+};
+std::mutex top_mtx;
+std::vector<std::unique_ptr<TopHeaps>> top_heaps;
+
+TopHeaps& thread_top(){
+    thread_local TopHeaps* mine = nullptr;
+    if(!mine){
+        std::lock_guard<std::mutex> lock(top_mtx);
+        top_heaps.push_back(std::make_unique<TopHeaps>(TopHeaps{TopHeap(top_n), TopHeap(top_n)}));
+        mine = top_heaps.back().get();
+    }
+    return *mine;
+}
+bool FLAG_HARDLINKS = false; // --hardlinks: count blocks/bytes of each inode once
+thread_local InodeSet seen_inodes; // hardlinked inodes (nlink > 1) already counted
+SortOrder sort_order = SortOrder::NAME;
+OutFormat out_format = OutFormat::TREE; // --format=ndjson|binary
+bool FLAG_UNSORTED = false; // -U: stream entries in directory order, bounded memory
+size_t sort_mem = 0;        // --sort-mem: stream sorted, spilling listings above this many bytes
+int max_depth = 0; // -L: levels below the root to descend into, 0 = no limit
+NameFilter name_filter; // --exclude / --include
+bool FLAG_GITIGNORE = false; // --gitignore: skip what .gitignore/.ignore files exclude
+bool FLAG_COLOR = false; // --color: auto (stdout is a TTY, the default), always or never
+ColorTable colors;       // built-in palette, overridden by LS_COLORS
+int columns = 0; // -p -u -g -s -D: ColumnFlag bits of the metadata shown before names
+TreeIndex prev_index;               // --index: listings from the previous run
+std::unique_ptr<IndexWriter> index_writer;
+std::mutex index_mtx; // roots listed in parallel share index_writer
+
+std::string join_path(const std::string& dir, const std::string& name);
+
+// One directory listing, filled in by whichever thread scans it and then
+// consumed (in sorted order) by the printing thread. Directories are opened
+// relative to their parent's fd, which stays open until every child has been
+// opened, so only the root is ever looked up by its full path.
+struct DirNode{
+    std::string name;   // full path for the root, bare entry name otherwise
+    DirNode* parent;
+    int depth;          // 0 for the root
+    bool open_by_path = false; // added by --watch after the parent's fd was closed
+    int fd = -1;
+    int wd = -1;        // inotify watch, --watch only
+    std::atomic<int> pending_opens{0}; // children that still need openat(fd, ...)
+    struct stat dir_stat; // fstat() of fd, only taken with --index
+    uint32_t index = 0;        // position in the parent's listing, i.e. print order
+    uint64_t ino = 0, dev = 0; // from the parent's listing; --top ranks ties by them
+    std::string index_path; // --index: full path, handed down by the parent's scan
+    std::shared_ptr<const IgnoreLevel> ignore; // --gitignore: innermost rules in effect here
+    std::string err_msg;
+    EntryTable entries; // everything printed or counted comes from these records
+    std::vector<std::unique_ptr<DirNode>> children; // per entry, null if not descended
+    std::atomic<bool> ready{false};
+
+    // --du: totals of everything below this directory, summed bottom-up. A
+    // directory is done once itself and every subdirectory have been scanned.
+    std::atomic<int64_t> du_bytes{0}, du_files{0}, du_blocks{0};
+    std::atomic<int> du_pending{1};
+    std::atomic<bool> subtree_done{false};
+
+    DirNode(std::string n, DirNode* p) : name(std::move(n)), parent(p), depth(p ? p->depth + 1 : 0) {}
+    ~DirNode(){if(fd != -1){close(fd);}}
+
+    void release_fd(){
+        close(fd);
+        fd = -1;
+    }
+
+    // Only used for messages, --index keys, --du=post and --top; traversal
+    // itself never needs the full path. Sized first and then filled in from
+    // the end, so a call is O(path length) however deep the node is.
+    std::string path() const{
+        size_t len = 0;
+        for(const DirNode* n=this;n;n=n->parent){len += n->name.size() + 1;}
+        std::string p(len, '/');
+        size_t pos = len;
+        for(const DirNode* n=this;n;n=n->parent){
+            pos -= n->name.size();
+            memcpy(&p[pos], n->name.data(), n->name.size());
+            // like join_path(): no second '/' after a root such as "/"
+            if(n->parent && !(n->parent->name.size() && n->parent->name.back() == '/')){--pos;}
+        }
+        return p.substr(pos);
+    }
+};
+
+// Escapes are only written with --color=always, or when stdout is a TTY.
+void reset_color(){
+    if(FLAG_COLOR){out->append(colors.reset());}
+}
+
+void change_color4mode(uint32_t fmode, uint32_t target_mode, const char* name, size_t len){
+    if(!FLAG_COLOR){return;}
+    stat_count(CNT_COLORS);
+    if(const std::string* esc = colors.for_entry(fmode, target_mode, name, len)){out->append(*esc);}
+}
+
+std::string join_path(const std::string& dir, const std::string& name){
+    if(!dir.empty() && dir.back() == '/'){return dir + name;}
+    return dir + '/' + name;
+}
+
+void count_entry(const EntryRec& fe, int sign){
+    if(S_ISREG(fe.mode)){reg_total += sign;}
+    else if(S_ISDIR(fe.mode)){dir_total += sign;}
+    if(!FLAG_HARDLINKS){
+        blk_total += sign * fe.blocks;
+        return;
+    }
+    logical_bytes += sign * fe.size;
+    // Only inodes with other names need remembering. A removed hardlink
+    // (--watch) leaves the unique usage alone: another name still has it.
+    if(fe.nlink > 1 && !S_ISDIR(fe.mode)){
+        if(sign < 0 || !seen_inodes.insert(fe.dev, fe.ino)){return;}
+    }
+    blk_total += sign * fe.blocks;
+    unique_bytes += sign * fe.size;
+}
+
+// " [bytes, files, blocks]" for a directory line in --du mode.
+void print_du_totals(const DirNode* node){
+    out->append(" [", 2);
+    out->append_int(node->du_bytes.load()); out->append(" bytes, ");
+    out->append_int(node->du_files.load()); out->append(" files, ");
+    out->append_int(node->du_blocks.load()); out->append(" blocks]");
+}
+
+int print_filename(const EntryTable& tbl, const EntryRec& fe, const DirNode* child){
+    uint64_t t0 = stat_start();
+    int fmode = fe.mode;
+    int shown_mode = S_ISLNK(fmode) ? fe.target_mode : fmode;
+    out->append(S_ISDIR(shown_mode) ? "+---+ " : "+---- ", 6);
+
+    count_entry(fe, 1);
+
+    if(columns){
+        static thread_local ColumnRenderer renderer;
+        char buf[128];
+        out->append(buf, renderer.render(buf, fe, columns));
+    }
+    change_color4mode(fmode, fe.target_mode, tbl.name(fe), fe.name_len);
+    out->append(tbl.name(fe), fe.name_len);
+    if(S_ISLNK(fmode)){
+        out->append(" -> ", 4);
+        change_color4mode(fe.target_mode, 0, tbl.link(fe), fe.link_len);
+        out->append(tbl.link(fe), fe.link_len);
+    }
+    if(child && du_mode == DuMode::PRE){print_du_totals(child);}
+    out->put('\n');
+    reset_color();
+    stat_end(OP_PRINT, t0);
+    return fmode;
+}
+
+class TraversalPool;
+
+// Reads and stats one directory. Subdirectories get a pending child node,
+// which is handed to the pool (if any) so workers can scan ahead of printing.
+void scan_directory(DirNode* node, TraversalPool* pool);
+
+/**
+ * Pool of directory scanners fed from one queue ordered by print order: a
+ * worker always takes the pending directory the printer will reach first,
+ * so the directories scanned ahead are the ones needed next.
+ *
+ * Scanning ahead is bounded: once max_ahead entries sit in listings the
+ * printer has not fetched yet, workers stop taking work until it catches
+ * up, so -j holds about as much as the serial walk. The printer never waits
+ * on a directory no worker has picked up; it takes it off the queue (where
+ * it is necessarily first) and scans it itself.
+ */
+class TraversalPool{
+public:
+    TraversalPool(int nworkers, int64_t max_ahead) : max_ahead(max_ahead){
+        for(int i=0;i<nworkers;++i){
+            workers.emplace_back(&TraversalPool::worker_main, this);
+        }
+    }
+
+    ~TraversalPool(){
+        {
+            std::lock_guard<std::mutex> lock(work_mtx);
+            stopping = true;
+        }
+        work_cv.notify_all();
+        for(auto& t : workers){t.join();}
+    }
+
+    // Called by scanners for the subdirectories they discover and by the
+    // printing thread for the root.
+    void submit(DirNode* node){
+        {
+            std::lock_guard<std::mutex> lock(work_mtx);
+            tasks.push(node);
+        }
+        work_cv.notify_one();
+    }
+
+    // Blocks until a worker sets flag (a node's ready or subtree_done).
+    void wait_ready(std::atomic<bool>& flag){
+        if(flag.load(std::memory_order_acquire)){return;}
+        std::unique_lock<std::mutex> lock(ready_mtx);
+        ready_cv.wait(lock, [&flag]{return flag.load(std::memory_order_acquire);});
+    }
+
+    void mark_ready(std::atomic<bool>& flag){
+        {
+            std::lock_guard<std::mutex> lock(ready_mtx);
+            flag.store(true, std::memory_order_release);
+        }
+        ready_cv.notify_all();
+    }
+
+    // Printing thread: returns once node is scanned, scanning it inline if
+    // it is still queued, and takes its entries off the scan-ahead budget.
+    void fetch(DirNode* node){
+        if(!node->ready.load(std::memory_order_acquire)){
+            if(take(node)){run(node);}
+            else{wait_ready(node->ready);}
+        }
+        int64_t n = node->entries.size();
+        if(ahead.fetch_sub(n) >= max_ahead && ahead.load() < max_ahead){
+            std::lock_guard<std::mutex> lock(work_mtx);
+            work_cv.notify_all();
+        }
+    }
+
+private:
+    // Everything printed before a queued directory has been fetched, so
+    // queued directories are never ancestors of one another: they are
+    // ordered by their subtrees below the deepest common ancestor.
+    static bool printed_before(const DirNode* a, const DirNode* b){
+        while(a->depth > b->depth){a = a->parent;}
+        while(b->depth > a->depth){b = b->parent;}
+        while(a->parent != b->parent){
+            a = a->parent;
+            b = b->parent;
+        }
+        return a->index < b->index;
+    }
+
+    struct PrintedLater{
+        bool operator()(const DirNode* a, const DirNode* b) const{return printed_before(b, a);}
+    };
+
+    std::priority_queue<DirNode*, std::vector<DirNode*>, PrintedLater> tasks; // top: printed first
+    std::vector<std::thread> workers;
+    std::atomic<int64_t> ahead{0}; // entries scanned but not fetched yet
+    int64_t max_ahead;
+    bool stopping = false;
+    std::mutex work_mtx, ready_mtx;
+    std::condition_variable work_cv, ready_cv;
+
+    // The directory the printer waits for is first in the queue if it is
+    // still there.
+    bool take(DirNode* node){
+        std::lock_guard<std::mutex> lock(work_mtx);
+        if(tasks.empty() || tasks.top() != node){return false;}
+        tasks.pop();
+        return true;
+    }
+
+    void run(DirNode* node){
+        uint64_t t0 = stat_start();
+        scan_directory(node, this);
+        stat_end(OP_SCAN, t0, node->err_msg.empty());
+        ahead.fetch_add(node->entries.size());
+        mark_ready(node->ready);
+    }
+
+    void worker_main(){
+        while(true){
+            DirNode* node;
+            {
+                std::unique_lock<std::mutex> lock(work_mtx);
+                work_cv.wait(lock, [this]{return stopping || (!tasks.empty() && ahead.load() < max_ahead);});
+                if(stopping){return;}
+                node = tasks.top();
+                tasks.pop();
+            }
+            run(node);
+        }
+    }
+};
+
+/**
+ * inotify side of --watch. Every directory gets a watch as soon as it is
+ * opened (through /proc/self/fd, before it is read, so nothing created
+ * while it is being listed is missed), mapped back to its DirNode.
+ */
+class TreeWatcher{
+public:
+    static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                                     | IN_ATTRIB | IN_CLOSE_WRITE | IN_ONLYDIR | IN_EXCL_UNLINK;
+    int fd = -1;
+
+    bool init(){
+        fd = inotify_init1(IN_CLOEXEC);
+        return fd != -1;
+    }
+
+    void add(DirNode* node, int dirfd){
+        char proc_path[48];
+        snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", dirfd);
+        int wd = inotify_add_watch(fd, proc_path, WATCH_MASK);
+        std::lock_guard<std::mutex> lock(mtx);
+        if(wd == -1){
+            if(!warned){
+                fprintf(stderr, "Unable to watch %s : %s (raise fs.inotify.max_user_watches?)\n",
+                        node->path().c_str(), strerror(errno));
+                warned = true;
+            }
+            return;
+        }
+        node->wd = wd;
+        nodes[wd] = node;
+    }
+
+    DirNode* find(int wd){
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = nodes.find(wd);
+        return it == nodes.end() ? nullptr : it->second;
+    }
+
+    void remove(DirNode* node){
+        if(node->wd == -1){return;}
+        inotify_rm_watch(fd, node->wd);
+        std::lock_guard<std::mutex> lock(mtx);
+        nodes.erase(node->wd);
+        node->wd = -1;
+    }
+
+private:
+    std::mutex mtx;
+    std::unordered_map<int, DirNode*> nodes;
+    bool warned = false;
+};
+
+std::unique_ptr<TreeWatcher> watcher;
+
+/**
+ * Stats every entry in todo relative to dirfd: the entry itself, or the
+ * symlink target when follow is set. With --uring the whole batch is queued
+ * on the thread's ring at once; entries the ring could not handle (no ring,
+ * kernel without IORING_OP_STATX) fall back to fstatat(). Entries that
+ * vanished since readdir are left with st_mode 0.
+ */
+void stat_entries(int dirfd, EntryTable& tbl, const std::vector<uint32_t>& todo, bool follow){
+    int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+    size_t n = todo.size();
+    std::vector<int> res(n, -EINVAL);
+    std::vector<struct statx> sx;
+    if(FLAG_URING && n > 1){
+        static thread_local UringStat ring;
+        std::vector<const char*> names(n);
+        for(size_t i=0;i<n;++i){names[i] = tbl.name(tbl[todo[i]]);}
+        sx.resize(n);
+        uint64_t t0 = stat_start();
+        bool ok = ring.ok() && ring.statx_all(dirfd, names, flags | AT_STATX_SYNC_AS_STAT, sx.data(), res.data());
+        if(ring.ok()){
+            stat_end(OP_URING_BATCH, t0, ok);
+            stat_count(CNT_URING_STATS, n);
+        }
+        if(!ok){res.assign(n, -EINVAL);}
+    }
+    for(size_t i=0;i<n;++i){
+        EntryRec& fe = tbl[todo[i]];
+        struct stat st;
+        bool ok;
+        if(res[i] == -EINVAL){
+            uint64_t t0 = stat_start();
+            ok = fstatat(dirfd, tbl.name(fe), &st, flags) == 0;
+            stat_end(OP_STAT, t0, ok);
+        }
+        else{
+            ok = res[i] == 0;
+            if(ok){statx_to_stat(sx[i], st);}
+        }
+        if(follow){fe.target_mode = ok ? st.st_mode : 0;}
+        else if(ok){tbl.set_stat(fe, st);}
+    }
+}
+
+void read_link_target(int dirfd, EntryTable& tbl, EntryRec& fe){
+    static thread_local std::vector<char> buf;
+    buf.resize(std::max<size_t>(fe.size + 1, PATH_MAX));
+    uint64_t t0 = stat_start();
+    ssize_t n = readlinkat(dirfd, tbl.name(fe), buf.data(), buf.size());
+    stat_end(OP_READLINK, t0, n >= 0);
+    if(n >= 0){tbl.set_link(fe, buf.data(), n);}
+}
+
+// Fills in metadata for freshly read entries: from d_type alone in --fast
+// mode, otherwise with one lstat-equivalent per entry. Symlinks also get
+// their target read, and stat()ed unless the thread's LinkCache already
+// knows where that target leads (--watch always stats, the tree changes).
+void read_entry_stats(int dirfd, EntryTable& tbl){
+    static thread_local LinkCache link_cache;
+    std::vector<uint32_t> todo;
+    for(uint32_t i=0;i<tbl.size();++i){
+        EntryRec& fe = tbl[i];
+        if(FLAG_FAST && !FLAG_BLOCKS && fe.dtype != DT_UNKNOWN){
+            // d_type alone is enough to draw the tree and count files/dirs
+            fe.mode = DTTOIF(fe.dtype);
+        }
+        else{todo.push_back(i);}
+    }
+    stat_entries(dirfd, tbl, todo, false);
+    tbl.remove_unstated(); // removed since readdir
+
+    todo.clear();
+    // Links of this listing sharing a target are stat()ed once: pending maps
+    // each new key to the entry standing in for it, dups are filled after.
+    std::unordered_map<std::string, uint32_t> pending;
+    std::vector<std::pair<uint32_t, uint32_t>> dups;
+    struct stat dir_st;
+    bool have_dir_st = false;
+    std::string key;
+    for(uint32_t i=0;i<tbl.size();++i){
+        EntryRec& fe = tbl[i];
+        if(!S_ISLNK(fe.mode)){continue;}
+        read_link_target(dirfd, tbl, fe);
+        if(FLAG_WATCH || fe.link_len == 0){
+            todo.push_back(i);
+            continue;
+        }
+        if(tbl.link(fe)[0] != '/' && !have_dir_st){
+            if(fstat(dirfd, &dir_st) == -1){memset(&dir_st, 0, sizeof(dir_st));}
+            have_dir_st = true;
+        }
+        LinkCache::make_key(key, &dir_st, tbl.link(fe), fe.link_len);
+        uint32_t mode;
+        if(link_cache.find(key, mode)){
+            fe.target_mode = mode;
+            stat_count(CNT_LINK_CACHE_HITS);
+            continue;
+        }
+        auto ins = pending.emplace(key, i);
+        if(!ins.second){
+            dups.emplace_back(i, ins.first->second);
+            stat_count(CNT_LINK_CACHE_HITS);
+            continue;
+        }
+        todo.push_back(i);
+    }
+    stat_entries(dirfd, tbl, todo, true);
+    for(auto& p : pending){link_cache.insert(p.first, tbl[p.second].target_mode);}
+    for(auto& d : dups){tbl[d.first].target_mode = tbl[d.second].target_mode;}
+}
+
+// Whether subdirectories of node are scanned (-L).
+bool descend_below(const DirNode* node){
+    return max_depth <= 0 || node->depth + 1 < max_depth;
+}
+
+// Appends the rules of ignore file name in node's directory, if present.
+void read_ignore_file(int dirfd, const char* name, IgnoreRules& rules){
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if(fd == -1){return;}
+    std::string text;
+    char buf[8192];
+    ssize_t n;
+    while((n = read(fd, buf, sizeof(buf))) > 0){text.append(buf, n);}
+    close(fd);
+    rules.parse(text.data(), text.size());
+}
+
+// Pushes a new ignore level for node if its listing has ignore files. Only
+// the names already in hand are checked, so directories without one cost
+// no extra syscalls. .ignore is read last and so overrides .gitignore.
+// Without a listing (tbl null, streaming modes) both files are just tried.
+void load_ignore_rules(DirNode* node, int dirfd, const EntryTable* tbl){
+    bool has_git = !tbl, has_plain = !tbl;
+    for(size_t i=0;tbl && i<tbl->size();++i){
+        const char* name = tbl->name((*tbl)[i]);
+        if(name[0] != '.'){continue;}
+        if(strcmp(name, ".gitignore") == 0){has_git = true;}
+        else if(strcmp(name, ".ignore") == 0){has_plain = true;}
+    }
+    if(!has_git && !has_plain){return;}
+    auto level = std::make_shared<IgnoreLevel>();
+    if(has_git){read_ignore_file(dirfd, ".gitignore", level->rules);}
+    if(has_plain){read_ignore_file(dirfd, ".ignore", level->rules);}
+    if(level->rules.empty()){return;}
+    level->depth = node->depth;
+    level->up = node->ignore;
+    node->ignore = std::move(level);
+}
+
+// Walks the ignore stack from the innermost level out; the first level
+// with a matching rule decides.
+bool is_ignored(const DirNode* node, const char* name, size_t len, bool is_dir){
+    if(is_dir && strcmp(name, ".git") == 0){return true;}
+    for(const IgnoreLevel* lv=node->ignore.get(); lv; lv=lv->up.get()){
+        int rule = lv->rules.match(name, len, is_dir, [&]{
+            std::string rel = name;
+            for(const DirNode* d=node; d->depth > lv->depth; d=d->parent){rel = d->name + '/' + rel;}
+            return rel;
+        });
+        if(rule != -1){return !lv->rules.negated(rule);}
+    }
+    return false;
+}
+
+// Drops ignored entries: before stats those whose d_type tells whether they
+// are directories, after stats (stated) the rest.
+void prune_ignored(const DirNode* node, EntryTable& tbl, bool stated){
+    tbl.remove_if([&](const EntryRec& r){
+        if((r.dtype == DT_UNKNOWN) != stated){return false;}
+        bool is_dir = stated ? S_ISDIR(r.mode) : r.dtype == DT_DIR;
+        return is_ignored(node, tbl.name(r), r.name_len, is_dir);
+    });
+}
+
+void sort_listing(EntryTable& tbl){
+    uint64_t t0 = stat_start();
+    sort_entries(tbl, sort_order, FLAG_REVERSE);
+    stat_end(OP_SORT, t0);
+}
+
+int open_directory(DirNode* node){
+    const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    DirNode* parent = node->parent;
+    bool by_path = !parent || node->open_by_path;
+    uint64_t t0 = stat_start();
+    int fd = by_path ? open(node->path().c_str(), flags) : openat(parent->fd, node->name.c_str(), flags);
+    int saved_errno = errno;
+    stat_end(OP_OPEN, t0, fd != -1);
+    if(!by_path && parent->pending_opens.fetch_sub(1) == 1){parent->release_fd();}
+    errno = saved_errno;
+    return fd;
+}
+
+// Called once per scanned directory (with du_pending covering itself plus
+// its subdirectories): completes every ancestor whose last pending
+// subdirectory this was, adding its totals into the parent.
+void du_finish(DirNode* node, TraversalPool* pool){
+    std::string path; // --top: node's path once built, trimmed on the way up
+    while(node && node->du_pending.fetch_sub(1) == 1){
+        DirNode* parent = node->parent;
+        if(parent){
+            parent->du_bytes  += node->du_bytes;
+            parent->du_files  += node->du_files;
+            parent->du_blocks += node->du_blocks;
+        }
+        // A directory that could not be opened has no size to rank.
+        if(du_mode == DuMode::TOP && !(node->entries.size() == 0 && !node->err_msg.empty())){
+            int64_t key = top_blocks ? node->du_blocks.load() : node->du_bytes.load();
+            TopHeap& dirs = thread_top().dirs;
+            if(dirs.wants(key, node->ino, node->dev)){
+                if(path.empty()){path = node->path();}
+                dirs.push(key, node->ino, node->dev, path);
+            }
+        }
+        if(pool){pool->mark_ready(node->subtree_done);}
+        else{node->subtree_done = true;}
+        if(!path.empty() && parent){
+            path.resize(path.size() - node->name.size());
+            if(parent->name.empty() || parent->name.back() != '/'){path.pop_back();}
+        }
+        node = parent;
+    }
+}
+
+// --top: offers node's regular files; a path is only built for files that
+// make it into the heap.
+void offer_top_files(const DirNode* node){
+    const EntryTable& tbl = node->entries;
+    TopHeap& files = thread_top().files;
+    std::string dir;
+    for(size_t i=0;i<tbl.size();++i){
+        const EntryRec& r = tbl[i];
+        int64_t key = top_blocks ? r.blocks : r.size;
+        if(!S_ISREG(r.mode) || !files.wants(key, r.ino, r.dev)){continue;}
+        if(dir.empty()){dir = node->path();}
+        files.push(key, r.ino, r.dev, join_path(dir, tbl.name_str(r)));
+    }
+}
+
+void scan_directory(DirNode* node, TraversalPool* pool){
+    static thread_local std::vector<char> dirent_buf;
+    int dirfd = open_directory(node);
+    if(dirfd == -1){
+        node->err_msg = "Unable to open " + node->path() + " : " + strerror(errno) + '\n';
+        if(du_mode != DuMode::NONE){du_finish(node, pool);}
+        return ;
+    }
+    node->fd = dirfd;
+    if(watcher){watcher->add(node, dirfd);}
+    EntryTable& tbl = node->entries;
+    bool reused = false;
+    std::string path; // --index only
+    if(index_writer){
+        path = node->index_path.empty() ? node->path() : std::move(node->index_path);
+        if(fstat(dirfd, &node->dir_stat) == -1){memset(&node->dir_stat, 0, sizeof(node->dir_stat));}
+        reused = prev_index.lookup(path, node->dir_stat, FLAG_BLOCKS || !FLAG_FAST, tbl);
+    }
+    if(!reused){
+        DirReader reader(dirfd, dirent_buf);
+        const char* name;
+        size_t name_len;
+        unsigned char dtype;
+        uint64_t ino;
+        while(reader.next(name, name_len, dtype, ino)){
+            tbl.add(name, name_len, dtype, ino);
+        }
+        if(reader.error()){
+            node->err_msg = "Unable to read " + node->path() + " : " + strerror(reader.error()) + '\n';
+        }
+        if(name_filter.active()){name_filter.prune_unstated(tbl);}
+        if(FLAG_GITIGNORE){
+            load_ignore_rules(node, dirfd, &tbl);
+            prune_ignored(node, tbl, false);
+        }
+        read_entry_stats(dirfd, tbl);
+        if(name_filter.active()){name_filter.prune_stated(tbl);}
+        if(FLAG_GITIGNORE){prune_ignored(node, tbl, true);}
+    }
+    stat_count(CNT_DIRS);
+    stat_count(CNT_ENTRIES, tbl.size());
+    sort_listing(tbl);
+
+    int len = tbl.size(), subdirs = 0;
+    // A listing that failed partway is not printed, so nothing below it is
+    // scanned either: its node may be freed as soon as its parent is done.
+    bool descend = descend_below(node) && node->err_msg.empty();
+    node->children.resize(len);
+    for(int i=0;i<len;++i){
+        if(!descend || !S_ISDIR(tbl[i].mode)){continue;}
+        node->children[i] = std::make_unique<DirNode>(tbl.name_str(tbl[i]), node);
+        node->children[i]->index = i;
+        node->children[i]->ino = tbl[i].ino;
+        node->children[i]->dev = tbl[i].dev;
+        if(index_writer){node->children[i]->index_path = join_path(path, tbl.name_str(tbl[i]));}
+        node->children[i]->ignore = node->ignore;
+        ++subdirs;
+    }
+    node->pending_opens.store(subdirs);
+    if(subdirs == 0){node->release_fd();}
+    if(du_mode != DuMode::NONE){
+        int64_t bytes = 0, files = 0, blocks = 0;
+        for(int i=0;i<len;++i){
+            bytes  += tbl[i].size;
+            blocks += tbl[i].blocks;
+            files  += S_ISREG(tbl[i].mode);
+        }
+        node->du_bytes += bytes;
+        node->du_files += files;
+        node->du_blocks += blocks;
+        if(du_mode == DuMode::TOP){offer_top_files(node);}
+        node->du_pending.store(subdirs + 1);
+        // Children are submitted below, after du_pending covers them.
+        du_finish(node, pool);
+    }
+    if(!pool){return;}
+    for(int i=0;i<len;++i){
+        if(node->children[i]){pool->submit(node->children[i].get());}
+    }
+}
+
+// Serial mode: scans node unless an earlier --du pass already did.
+void ensure_scanned(DirNode* node){
+    if(node->ready){return;}
+    uint64_t t0 = stat_start();
+    scan_directory(node, nullptr);
+    stat_end(OP_SCAN, t0, node->err_msg.empty());
+    node->ready = true;
+}
+
+// Scans every directory below top that is not scanned yet, all inline.
+void scan_subtree(DirNode* top){
+    std::vector<DirNode*> todo = {top};
+    while(!todo.empty()){
+        DirNode* node = todo.back();
+        todo.pop_back();
+        ensure_scanned(node);
+        for(auto& child : node->children){
+            if(child){todo.push_back(child.get());}
+        }
+    }
+}
+
+// --du pre-order: a directory line can only be printed once its whole
+// subtree has been scanned.
+void wait_subtree(DirNode* node, TraversalPool* pool){
+    if(pool){pool->wait_ready(node->subtree_done);}
+    else{scan_subtree(node);}
+}
+
+// Makes node's listing available to the printing thread. On failure the
+// error is printed in place of the listing. path is node's full path, only
+// needed with --index.
+bool fetch_listing(DirNode* node, TraversalPool* pool, const std::string& path){
+    if(pool){pool->fetch(node);}
+    else{ensure_scanned(node);}
+    if(node->err_msg.empty()){
+        if(index_writer){
+            std::lock_guard<std::mutex> lock(index_mtx);
+            index_writer->add_dir(path, node->dir_stat, FLAG_BLOCKS || !FLAG_FAST, node->entries);
+        }
+        return true;
+    }
+    if(out_format == OutFormat::TREE && du_mode != DuMode::TOP){out->append(node->err_msg);}
+    else{fputs(node->err_msg.c_str(), stderr);}
+    return false;
+}
+
+// --du=post: "bytes<TAB>files<TAB>blocks<TAB>path", emitted as soon as the
+// printing thread is done with a directory.
+void print_du_line(DirNode* node, TraversalPool* pool, const std::string& path){
+    if(pool){pool->wait_ready(node->subtree_done);}
+    out->append_int(node->du_bytes.load()); out->put('\t');
+    out->append_int(node->du_files.load()); out->put('\t');
+    out->append_int(node->du_blocks.load()); out->put('\t');
+    out->append(path);
+    out->put('\n');
+}
+
+/**
+ * Prints the tree below root without recursion. The indentation for every
+ * open level lives in one shared prefix string (4 bytes per level), which is
+ * extended when descending and truncated when a directory is finished, so
+ * each line costs a single append regardless of depth.
+ */
+int print_directory(DirNode* root, TraversalPool* pool){
+    struct Frame{
+        DirNode* node;
+        int next;        // index of the next entry to print
+        size_t path_len; // length of node's path plus '/' in path
+    };
+    bool records = out_format != OutFormat::TREE;
+    bool tree_lines = du_mode != DuMode::POST && du_mode != DuMode::TOP && !records;
+    // Full paths are carried down the walk rather than rebuilt per node.
+    bool track_path = records || du_mode == DuMode::POST || index_writer;
+
+    if(du_mode == DuMode::PRE){wait_subtree(root, pool);}
+    if(!fetch_listing(root, pool, root->name)){return -1;}
+    if(tree_lines){
+        change_color4mode(S_IFDIR, 0, nullptr, 0);
+        out->append(root->name);
+        if(du_mode == DuMode::PRE){print_du_totals(root);}
+        out->put('\n');
+        reset_color();
+    }
+
+    std::vector<Frame> stack = {{root, 0, 0}};
+    std::string prefix, path;
+    if(track_path){
+        path = root->name;
+        if(path.empty() || path.back() != '/'){path.push_back('/');}
+        stack.back().path_len = path.size();
+    }
+    while(!stack.empty()){
+        if(out->failed()){return -1;} // the reader is gone, stop walking
+        DirNode* node = stack.back().node;
+        int len = node->entries.size();
+        int i = stack.back().next++;
+        if(i < len){
+            DirNode* child = node->children[i].get();
+            if(child && du_mode == DuMode::PRE){wait_subtree(child, pool);}
+            const EntryRec& fe = node->entries[i];
+            if(track_path && (records || child)){
+                path.resize(stack.back().path_len);
+                path.append(node->entries.name(fe), fe.name_len);
+            }
+            if(tree_lines){
+                out->append(prefix);
+                print_filename(node->entries, fe, child);
+            }
+            else if(records){
+                count_entry(fe, 1);
+                if(out_format == OutFormat::NDJSON){append_ndjson(*out, path, node->depth + 1, node->entries, fe);}
+                else{append_binary(*out, path, node->depth + 1, node->entries, fe);}
+            }
+            else{count_entry(fe, 1);}
+            if(!child){continue;}
+            prefix.append(i == len-1 ? "    " : "|   ", 4);
+            if(fetch_listing(child, pool, path)){
+                if(track_path){path.push_back('/');}
+                stack.push_back({child, 0, path.size()});
+                continue;
+            }
+            // A failed directory has no children queued (see scan_directory),
+            // so it can go along with its parent.
+        }
+        else{
+            if(tree_lines){reset_color();}
+            else if(du_mode == DuMode::POST){
+                print_du_line(node, pool, node == root ? root->name : path.substr(0, stack.back().path_len - 1));
+            }
+            else if(du_mode == DuMode::TOP && pool){pool->wait_ready(node->subtree_done);}
+            stack.pop_back();
+            if(stack.empty()){break;}
+            Frame& parent = stack.back();
+            if(!FLAG_WATCH){parent.node->children[parent.next - 1].reset();}
+        }
+        if(tree_lines){
+            out->append(prefix);
+            out->put('\n');
+        }
+        prefix.resize(prefix.size() - 4);
+    }
+    return 0;
+}
+
+const size_t STREAM_CHUNK = 1024;         // entries handed out per fill()
+const size_t STREAM_DIRENT_BUF = 1 << 15; // getdents buffer per directory still being read
+
+/**
+ * One directory in the streaming modes (-U, --sort-mem), handed out in
+ * chunks of at most STREAM_CHUNK entries. With -U they come straight from
+ * getdents in directory order. Otherwise the listing is read up front and
+ * sorted in memory, or, once it outgrows sort_mem, sorted in runs that are
+ * spilled to a temp file and merged back (SpillRuns).
+ */
+class ListingStream{
+public:
+    ListingStream(DirNode* n) : node(n), reader(n->fd, dirent_buf, STREAM_DIRENT_BUF) {}
+
+    // Appends at least one more entry to tbl, false once there are none.
+    bool fill(EntryTable& tbl){
+        if(FLAG_UNSORTED){
+            if(!read_chunk(chunk)){return false;}
+            for(auto& r : chunk.recs){tbl.append_from(chunk, r);}
+            if(exhausted){chunk = EntryTable();}
+            return true;
+        }
+        if(!loaded){load_sorted();}
+        size_t n = 0;
+        if(spill){
+            while(n < STREAM_CHUNK && spill->next(tbl)){++n;}
+            if(spill->error() && node->err_msg.empty()){
+                node->err_msg = "Unable to read back sorted runs of " + node->path() + " : "
+                              + strerror(spill->error()) + '\n';
+            }
+            return n > 0;
+        }
+        for(; n < STREAM_CHUNK && served < sorted.size(); ++n, ++served){
+            tbl.append_from(sorted, sorted[served]);
+        }
+        if(served == sorted.size()){
+            sorted = EntryTable();
+            served = 0;
+        }
+        return n > 0;
+    }
+
+private:
+    DirNode* node;
+    std::vector<char> dirent_buf;
+    DirReader reader;
+    bool exhausted = false;
+    EntryTable chunk;
+    bool loaded = false;
+    EntryTable sorted;
+    size_t served = 0;
+    std::unique_ptr<SpillRuns> spill;
+
+    // Replaces chunk with the next (non-empty) batch of filtered, stat()ed
+    // entries; false at the end of the directory.
+    bool read_chunk(EntryTable& out_tbl){
+        out_tbl.clear();
+        while(out_tbl.size() == 0 && !exhausted){
+            const char* name;
+            size_t name_len;
+            unsigned char dtype;
+            uint64_t ino;
+            while(out_tbl.size() < STREAM_CHUNK){
+                if(!reader.next(name, name_len, dtype, ino)){
+                    exhausted = true;
+                    break;
+                }
+                out_tbl.add(name, name_len, dtype, ino);
+            }
+            if(reader.error()){
+                node->err_msg = "Unable to read " + node->path() + " : " + strerror(reader.error()) + '\n';
+            }
+            // Most directories end within the first getdents call; the
+            // buffer is not needed while their subdirectories are walked.
+            if(exhausted){std::vector<char>().swap(dirent_buf);}
+            if(name_filter.active()){name_filter.prune_unstated(out_tbl);}
+            if(FLAG_GITIGNORE){prune_ignored(node, out_tbl, false);}
+            read_entry_stats(node->fd, out_tbl);
+            if(name_filter.active()){name_filter.prune_stated(out_tbl);}
+            if(FLAG_GITIGNORE){prune_ignored(node, out_tbl, true);}
+            stat_count(CNT_ENTRIES, out_tbl.size());
+        }
+        return out_tbl.size() > 0;
+    }
+
+    void spill_sorted(){
+        if(!spill){spill = std::make_unique<SpillRuns>(sort_order, FLAG_REVERSE);}
+        sort_listing(sorted);
+        if(!spill->add_run(sorted) && node->err_msg.empty()){
+            node->err_msg = "Unable to spill sorted runs of " + node->path() + " : "
+                          + strerror(spill->error() ? spill->error() : errno) + '\n';
+        }
+        sorted = EntryTable();
+    }
+
+    void load_sorted(){
+        loaded = true;
+        while(read_chunk(chunk)){
+            for(auto& r : chunk.recs){sorted.append_from(chunk, r);}
+            // sort_entries() needs two SortKey arrays on top of the records.
+            if(sorted.memory_bytes() + sorted.size() * 2 * sizeof(SortKey) > sort_mem){spill_sorted();}
+        }
+        chunk = EntryTable();
+        if(!spill){
+            sort_listing(sorted);
+            return;
+        }
+        if(sorted.size()){spill_sorted();}
+        if(!node->err_msg.empty() || !spill->start_merge(sort_mem)){
+            if(node->err_msg.empty()){
+                node->err_msg = "Unable to merge sorted runs of " + node->path() + " : "
+                              + strerror(spill->error()) + '\n';
+            }
+            spill.reset();
+        }
+    }
+};
+
+void print_stream_error(DirNode* node){
+    if(node->err_msg.empty()){return;}
+    if(out_format == OutFormat::TREE){out->append(node->err_msg);}
+    else{fputs(node->err_msg.c_str(), stderr);}
+}
+
+// Opens node for streaming (its parent's fd is still open) and loads its
+// ignore files. Failures are printed in place of the listing.
+bool open_stream_dir(DirNode* node){
+    const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    uint64_t t0 = stat_start();
+    node->fd = node->parent ? openat(node->parent->fd, node->name.c_str(), flags)
+                            : open(node->name.c_str(), flags);
+    int saved_errno = errno;
+    stat_end(OP_OPEN, t0, node->fd != -1);
+    errno = saved_errno;
+    if(node->fd == -1){
+        node->err_msg = "Unable to open " + node->path() + " : " + strerror(errno) + '\n';
+        print_stream_error(node);
+        return false;
+    }
+    stat_count(CNT_DIRS);
+    if(FLAG_GITIGNORE){load_ignore_rules(node, node->fd, nullptr);}
+    return true;
+}
+
+/**
+ * print_directory() for the streaming modes, serial and without DirNode
+ * listings: every open directory keeps its fd, reader and one chunk of
+ * entries on the stack, so memory depends on the depth of the tree rather
+ * than on the size of its directories. One entry of lookahead (carried over
+ * into the next chunk) tells whether an entry is the last one, which the
+ * tree lines need.
+ */
+int stream_directory(char* path){
+    struct Frame{
+        std::unique_ptr<DirNode> node;
+        std::unique_ptr<ListingStream> src;
+        EntryTable chunk;
+        size_t next = 0;
+        bool more = true;  // src may have entries after chunk
+        size_t path_len = 0;
+    };
+    bool records = out_format != OutFormat::TREE;
+
+    std::vector<Frame> stack(1);
+    stack[0].node = std::make_unique<DirNode>(path, nullptr);
+    if(!open_stream_dir(stack[0].node.get())){return -1;}
+    stack[0].src = std::make_unique<ListingStream>(stack[0].node.get());
+    std::string prefix, entry_path;
+    if(records){
+        entry_path = path;
+        if(entry_path.empty() || entry_path.back() != '/'){entry_path.push_back('/');}
+        stack[0].path_len = entry_path.size();
+    }
+    else{
+        change_color4mode(S_IFDIR, 0, nullptr, 0);
+        out->append(path);
+        out->put('\n');
+        reset_color();
+    }
+
+    while(!stack.empty()){
+        if(out->failed()){return -1;}
+        Frame& f = stack.back();
+        while(f.more && f.next + 1 >= f.chunk.size()){
+            EntryTable fresh;
+            if(f.next < f.chunk.size()){fresh.append_from(f.chunk, f.chunk[f.next]);}
+            f.more = f.src->fill(fresh);
+            f.chunk = std::move(fresh);
+            f.next = 0;
+        }
+        DirNode* node = f.node.get();
+        if(f.next < f.chunk.size()){
+            const EntryRec& fe = f.chunk[f.next++];
+            bool last = !f.more && f.next == f.chunk.size();
+            if(!records){
+                out->append(prefix);
+                print_filename(f.chunk, fe, nullptr);
+            }
+            else{
+                count_entry(fe, 1);
+                entry_path.resize(f.path_len);
+                entry_path.append(f.chunk.name(fe), fe.name_len);
+                if(out_format == OutFormat::NDJSON){append_ndjson(*out, entry_path, node->depth + 1, f.chunk, fe);}
+                else{append_binary(*out, entry_path, node->depth + 1, f.chunk, fe);}
+            }
+            if(!S_ISDIR(fe.mode) || !descend_below(node)){continue;}
+            prefix.append(last ? "    " : "|   ", 4);
+            auto child = std::make_unique<DirNode>(f.chunk.name_str(fe), node);
+            child->ignore = node->ignore;
+            if(open_stream_dir(child.get())){
+                Frame cf;
+                cf.src = std::make_unique<ListingStream>(child.get());
+                cf.node = std::move(child);
+                if(records){
+                    entry_path.push_back('/');
+                    cf.path_len = entry_path.size();
+                }
+                stack.push_back(std::move(cf));
+                continue;
+            }
+        }
+        else{
+            print_stream_error(node);
+            if(!records){reset_color();}
+            stack.pop_back();
+            if(stack.empty()){break;}
+        }
+        if(!records){
+            out->append(prefix);
+            out->put('\n');
+        }
+        prefix.resize(prefix.size() - 4);
+    }
+    return 0;
+}
+
+// With -j, workers stop scanning ahead once this many entries are waiting
+// to be printed. --du (pre-order) needs each subtree whole before its line,
+// as scan_subtree() does serially, so it is not bounded.
+const int64_t SCAN_AHEAD_ENTRIES = 1 << 13;
+
+int64_t scan_ahead_limit(){
+    return du_mode == DuMode::PRE ? INT64_MAX : SCAN_AHEAD_ENTRIES;
+}
+
+int list_directory(char* path){
+    if(FLAG_UNSORTED || sort_mem){return stream_directory(path);}
+    DirNode root(path, nullptr);
+    if(worker_cnt <= 0){return print_directory(&root, nullptr);}
+    TraversalPool pool(worker_cnt, scan_ahead_limit());
+    pool.submit(&root);
+    return print_directory(&root, &pool);
+}
+
+void print_totals(int ret){
+    if(ret == -1){out->append("\nAn Error occured!\n");}
+    out->append("*===============\n");
+    out->append("Total regular files: "); out->append_int(reg_total); out->put('\n');
+    out->append("Total directories: "); out->append_int(dir_total); out->put('\n');
+    if(FLAG_BLOCKS){out->append("Blocks used: "); out->append_int(blk_total); out->put('\n');}
+    if(FLAG_HARDLINKS){
+        out->append("Logical bytes: "); out->append_int(logical_bytes); out->put('\n');
+        out->append("Unique bytes: "); out->append_int(unique_bytes); out->put('\n');
+        out->append("Hardlinked inodes: "); out->append_int(seen_inodes.size()); out->put('\n');
+    }
+}
+
+// --top: merges every thread's heaps and prints the two lists, largest
+// first, as "size<TAB>path" (st_blocks with --top-by=blocks).
+void print_top(){
+    TopHeap files(top_n), dirs(top_n);
+    {
+        std::lock_guard<std::mutex> lock(top_mtx);
+        for(auto& t : top_heaps){
+            files.merge(t->files);
+            dirs.merge(t->dirs);
+        }
+    }
+    const char* by = top_blocks ? " by blocks:\n" : " by size:\n";
+    std::pair<const char*, TopHeap*> lists[2] = {{"Largest files", &files}, {"Largest directories", &dirs}};
+    for(auto& list : lists){
+        if(list.second == &dirs){out->put('\n');}
+        out->append(list.first);
+        out->append(by);
+        for(auto& item : list.second->take_sorted()){
+            out->append_int(item.key);
+            out->put('\t');
+            out->append(item.path);
+            out->put('\n');
+        }
+    }
+}
+
+// Lists one root argument with fresh totals.
+int list_root(char* path){
+    uint64_t t0 = stat_start();
+    if(out_format != OutFormat::TREE || du_mode == DuMode::TOP){
+        int ret = list_directory(path);
+        stat_end(OP_LIST, t0, ret == 0);
+        return ret;
+    }
+    if(du_mode != DuMode::POST){reset_color();}
+    reg_total = 0; dir_total = 0; blk_total = 0;
+    logical_bytes = 0; unique_bytes = 0;
+    seen_inodes = InodeSet();
+    int ret = list_directory(path);
+    print_totals(ret);
+    if(FLAG_HARDLINKS){
+        stat_count(CNT_HARDLINK_INODES, seen_inodes.size());
+        stat_count(CNT_INODE_SET_BYTES, seen_inodes.memory_bytes());
+    }
+    stat_end(OP_LIST, t0, ret == 0);
+    return ret;
+}
+
+/**
+ * Lists several roots at once. Roots are grouped by st_dev and each group
+ * gets one thread that lists its roots in argument order, so roots on
+ * different devices proceed in parallel while roots sharing a device do
+ * not compete for it. The first root writes straight to stdout; the others
+ * are spooled to anonymous temp files and copied out, in argument order,
+ * once every root before them is done.
+ */
+bool list_roots(std::vector<char*>& roots){
+    size_t n = roots.size();
+    std::vector<dev_t> devs(n);
+    std::vector<std::vector<size_t>> groups;
+    for(size_t i=0;i<n;++i){
+        struct stat st;
+        devs[i] = stat(roots[i], &st) == 0 ? st.st_dev : (dev_t)-1;
+        size_t g = 0;
+        while(g < groups.size() && devs[groups[g][0]] != devs[i]){++g;}
+        if(g == groups.size()){groups.emplace_back();}
+        groups[g].push_back(i);
+    }
+    if(groups.size() == 1){
+        for(auto root : roots){list_root(root);}
+        return true;
+    }
+
+    std::vector<int> spool(n, -1), spool_err(n, 0);
+    std::vector<bool> done(n, false);
+    std::mutex done_mtx;
+    std::condition_variable done_cv;
+    std::vector<std::thread> threads;
+    for(auto& group : groups){
+        threads.emplace_back([&, group]{
+            for(size_t i : group){
+                if(i == 0){list_root(roots[i]);}
+                else if((spool[i] = open_temp_file()) == -1){spool_err[i] = errno;}
+                else{
+                    OutBuffer buf(spool[i]);
+                    out = &buf;
+                    list_root(roots[i]);
+                    buf.flush();
+                    if(buf.failed()){spool_err[i] = errno ? errno : EIO;}
+                    out = &stdout_buf;
+                }
+                std::lock_guard<std::mutex> lock(done_mtx);
+                done[i] = true;
+                done_cv.notify_all();
+            }
+        });
+    }
+
+    bool ok = true;
+    std::vector<char> chunk(1 << 20);
+    for(size_t i=0;i<n;++i){
+        {
+            std::unique_lock<std::mutex> lock(done_mtx);
+            done_cv.wait(lock, [&]{return done[i];});
+        }
+        if(i == 0){continue;}
+        if(spool_err[i]){
+            fprintf(stderr, "Unable to spool output of %s : %s\n", roots[i], strerror(spool_err[i]));
+            ok = false;
+        }
+        if(spool[i] == -1){continue;}
+        off_t off = 0;
+        ssize_t got;
+        while((got = pread(spool[i], chunk.data(), chunk.size(), off)) > 0){
+            stdout_buf.append(chunk.data(), got);
+            off += got;
+        }
+        close(spool[i]);
+    }
+    for(auto& t : threads){t.join();}
+    return ok;
+}
+
+// Adds (sign 1) or removes (sign -1) everything below node to the totals.
+void count_subtree(DirNode* top, int sign){
+    std::vector<DirNode*> todo = {top};
+    while(!todo.empty()){
+        DirNode* node = todo.back();
+        todo.pop_back();
+        for(size_t i=0;i<node->entries.size();++i){count_entry(node->entries[i], sign);}
+        for(auto& child : node->children){
+            if(child){todo.push_back(child.get());}
+        }
+    }
+}
+
+void unwatch_subtree(DirNode* top){
+    std::vector<DirNode*> todo = {top};
+    while(!todo.empty()){
+        DirNode* node = todo.back();
+        todo.pop_back();
+        watcher->remove(node);
+        for(auto& child : node->children){
+            if(child){todo.push_back(child.get());}
+        }
+    }
+}
+
+int find_entry(DirNode* node, const char* name){
+    EntryTable& tbl = node->entries;
+    for(size_t i=0;i<tbl.size();++i){
+        if(strcmp(tbl.name(tbl[i]), name) == 0){return i;}
+    }
+    return -1;
+}
+
+// Re-sorts a listing after --watch edited it, keeping each child DirNode
+// attached to its entry.
+void resort_listing(DirNode* node){
+    std::unordered_map<std::string, std::unique_ptr<DirNode>> kids;
+    for(auto& child : node->children){
+        if(child){kids[child->name] = std::move(child);}
+    }
+    EntryTable& tbl = node->entries;
+    sort_listing(tbl);
+    node->children.clear();
+    node->children.resize(tbl.size());
+    for(size_t i=0;i<tbl.size();++i){
+        auto it = kids.find(tbl.name(tbl[i]));
+        if(it != kids.end()){node->children[i] = std::move(it->second);}
+    }
+}
+
+void print_change(char kind, const std::string& path, int fmode, int target_mode){
+    out->put(kind);
+    out->put(' ');
+    change_color4mode(fmode, target_mode, path.data(), path.size());
+    out->append(path);
+    reset_color();
+    out->put('\n');
+}
+
+// Drops entry i of node (and its subtree) from the tree and the totals.
+void watch_remove(DirNode* node, int i){
+    EntryTable& tbl = node->entries;
+    std::string path = join_path(node->path(), tbl.name_str(tbl[i]));
+    int fmode = tbl[i].mode, target_mode = tbl[i].target_mode;
+    count_entry(tbl[i], -1);
+    if(DirNode* child = node->children[i].get()){
+        count_subtree(child, -1);
+        unwatch_subtree(child);
+    }
+    tbl.remove(i);
+    node->children.erase(node->children.begin() + i);
+    print_change('-', path, fmode, target_mode);
+}
+
+// (Re)reads one entry of node after a create/move/attribute event.
+void watch_update(DirNode* node, const char* name){
+    int dirfd = open(node->path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dirfd == -1){return;}
+    EntryTable fresh;
+    fresh.add(name, strlen(name), DT_UNKNOWN, 0);
+    if(name_filter.active()){name_filter.prune_unstated(fresh);}
+    read_entry_stats(dirfd, fresh);
+    if(name_filter.active()){name_filter.prune_stated(fresh);}
+    if(FLAG_GITIGNORE){prune_ignored(node, fresh, true);}
+    close(dirfd);
+
+    int i = find_entry(node, name);
+    if(fresh.size() == 0){ // already gone again
+        if(i != -1){watch_remove(node, i);}
+        return;
+    }
+    const EntryRec& rec = fresh[0];
+    EntryTable& tbl = node->entries;
+    std::unique_ptr<DirNode> child;
+    char kind = '+';
+    if(i != -1){
+        // Same inode: metadata changed in place; otherwise it was replaced.
+        if(tbl[i].ino == rec.ino && tbl[i].mode == rec.mode){
+            count_entry(tbl[i], -1);
+            child = std::move(node->children[i]);
+            tbl.remove(i);
+            node->children.erase(node->children.begin() + i);
+            kind = '~';
+        }
+        else{watch_remove(node, i);}
+    }
+    tbl.append_from(fresh, rec);
+    count_entry(rec, 1);
+    if(S_ISDIR(rec.mode) && kind == '+' && descend_below(node)){
+        child = std::make_unique<DirNode>(name, node);
+        child->open_by_path = true;
+        child->ignore = node->ignore;
+        scan_subtree(child.get());
+        count_subtree(child.get(), 1);
+    }
+    node->children.push_back(std::move(child));
+    resort_listing(node);
+    print_change(kind, join_path(node->path(), name), rec.mode, rec.target_mode);
+}
+
+/**
+ * --watch main loop: waits for inotify events, applies each batch to the
+ * in-memory tree (only the affected directory entries are re-read) and
+ * prints one line per changed path followed by the updated totals.
+ */
+void watch_tree(DirNode* root){
+    alignas(struct inotify_event) char buf[1 << 16];
+    while(true){
+        out->flush();
+        if(out->failed()){return;}
+        ssize_t n = read(watcher->fd, buf, sizeof(buf));
+        if(n == -1 && errno == EINTR){continue;}
+        if(n <= 0){return;}
+        bool changed = false;
+        while(n > 0){
+            for(char* p=buf;p<buf+n;){
+                auto* ev = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + ev->len;
+                if(ev->mask & IN_Q_OVERFLOW){
+                    fprintf(stderr, "inotify queue overflowed, some changes were missed\n");
+                    continue;
+                }
+                DirNode* node = watcher->find(ev->wd);
+                if(!node || ev->len == 0){continue;}
+                if(ev->mask & (IN_DELETE | IN_MOVED_FROM)){
+                    int i = find_entry(node, ev->name);
+                    if(i != -1){watch_remove(node, i);}
+                }
+                else{watch_update(node, ev->name);}
+                changed = true;
+            }
+            // Coalesce bursts (e.g. an untar) into one totals update.
+            struct pollfd pfd = {watcher->fd, POLLIN, 0};
+            n = 0;
+            if(poll(&pfd, 1, 50) == 1){
+                n = read(watcher->fd, buf, sizeof(buf));
+            }
+        }
+        if(changed){print_totals(0);}
+        if(root->wd == -1){return;}
+    }
+}
+
+int watch_directory(char* path){
+    watcher = std::make_unique<TreeWatcher>();
+    if(!watcher->init()){
+        fprintf(stderr, "Unable to start inotify : %s\n", strerror(errno));
+        return -1;
+    }
+    DirNode root(path, nullptr);
+    int ret;
+    if(worker_cnt <= 0){ret = print_directory(&root, nullptr);}
+    else{
+        TraversalPool pool(worker_cnt, scan_ahead_limit());
+        pool.submit(&root);
+        ret = print_directory(&root, &pool);
+    }
+    print_totals(ret);
+    if(index_writer){
+        if(!index_writer->finish()){fprintf(stderr, "Unable to save index : %s\n", strerror(errno));}
+        index_writer.reset();
+    }
+    if(ret == 0){watch_tree(&root);}
+    return ret;
+}
+
+// Parses a positive decimal number (as for -j and -L), false otherwise.
+bool parse_count(const char* s, int& n){
+    if(*s < '0' || *s > '9'){return false;}
+    char* end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if(*end || errno || v <= 0 || v > INT_MAX){return false;}
+    n = v;
+    return true;
+}
+
+// Each directory on the current path (per worker) holds an fd, so lift the
+// soft limit up to the hard one for very deep trees.
+void raise_fd_limit(){
+    struct rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max){
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+int main(int argc, char** argv){
+    uint64_t start_ns = stat_clock();
+    // A closed pipe shows up as EPIPE from write(): output stops, exit status 1.
+    signal(SIGPIPE, SIG_IGN);
+    std::vector<char*> roots;
+    bool stats_json = false;
+    bool blocks_requested = false;
+    int color_mode = 0; // -1 never, 0 auto, 1 always
+    for(int i=1;i<argc;++i){
+        if(strcmp(argv[i], "--fast") == 0){FLAG_FAST = true; continue;}
+        if(strcmp(argv[i], "--blocks") == 0){blocks_requested = true; continue;}
+        if(strcmp(argv[i], "--uring") == 0){FLAG_URING = true; continue;}
+        if(strcmp(argv[i], "-r") == 0){FLAG_REVERSE = true; continue;}
+        if(strcmp(argv[i], "--watch") == 0){FLAG_WATCH = true; continue;}
+        if(strcmp(argv[i], "--gitignore") == 0){FLAG_GITIGNORE = true; continue;}
+        if(strcmp(argv[i], "--hardlinks") == 0){FLAG_HARDLINKS = true; continue;}
+        if(strcmp(argv[i], "--du") == 0){du_mode = DuMode::PRE; continue;}
+        if(strcmp(argv[i], "--du=post") == 0){du_mode = DuMode::POST; continue;}
+        if(strncmp(argv[i], "--top=", 6) == 0){
+            char* end;
+            long n = strtol(argv[i] + 6, &end, 10);
+            if(n <= 0 || *end){
+                fprintf(stderr, "Bad count '%s' for --top\n", argv[i] + 6);
+                return 1;
+            }
+            top_n = n;
+            continue;
+        }
+        if(strcmp(argv[i], "--top-by=size") == 0){top_blocks = false; continue;}
+        if(strcmp(argv[i], "--top-by=blocks") == 0){top_blocks = true; continue;}
+        if(strncmp(argv[i], "--index=", 8) == 0){
+            const char* file = argv[i] + 8;
+            prev_index.load(file);
+            index_writer = std::make_unique<IndexWriter>();
+            if(!index_writer->open_file(file)){
+                fprintf(stderr, "Unable to write index %s.tmp : %s\n", file, strerror(errno));
+                return 1;
+            }
+            continue;
+        }
+        if(strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=json") == 0){
+            stats_enabled = true;
+            stats_json = argv[i][7] == '=';
+            continue;
+        }
+        if(strcmp(argv[i], "-U") == 0){FLAG_UNSORTED = true; continue;}
+        if(argv[i][0] == '-' && argv[i][1] && strspn(argv[i] + 1, "pugsD") == strlen(argv[i] + 1)){
+            for(const char* c=argv[i]+1;*c;++c){
+                columns |= *c == 'p' ? COL_PERMS : *c == 'u' ? COL_USER : *c == 'g' ? COL_GROUP :
+                           *c == 's' ? COL_SIZE : COL_DATE;
+            }
+            continue;
+        }
+        if(strncmp(argv[i], "--color", 7) == 0 && (!argv[i][7] || argv[i][7] == '=')){
+            const char* when = argv[i][7] ? argv[i] + 8 : "always";
+            if(strcmp(when, "auto") == 0){color_mode = 0;}
+            else if(strcmp(when, "always") == 0){color_mode = 1;}
+            else if(strcmp(when, "never") == 0){color_mode = -1;}
+            else{
+                fprintf(stderr, "Unknown color mode '%s' (auto, always, never)\n", when);
+                return 1;
+            }
+            continue;
+        }
+        if(strncmp(argv[i], "--sort-mem=", 11) == 0){
+            char* end;
+            double v = strtod(argv[i] + 11, &end);
+            int shift = (*end == 'K' ? 10 : *end == 'M' ? 20 : *end == 'G' ? 30 : 0);
+            sort_mem = v * (1ULL << shift);
+            if(v <= 0 || end == argv[i] + 11 || (shift && end[1]) || (!shift && *end)){
+                fprintf(stderr, "Bad memory budget '%s' (e.g. 64M)\n", argv[i] + 11);
+                return 1;
+            }
+            continue;
+        }
+        if(strncmp(argv[i], "--format=", 9) == 0){
+            const char* fmt = argv[i] + 9;
+            if(strcmp(fmt, "tree") == 0){out_format = OutFormat::TREE;}
+            else if(strcmp(fmt, "ndjson") == 0){out_format = OutFormat::NDJSON;}
+            else if(strcmp(fmt, "binary") == 0){out_format = OutFormat::BINARY;}
+            else{
+                fprintf(stderr, "Unknown format '%s' (tree, ndjson, binary)\n", fmt);
+                return 1;
+            }
+            continue;
+        }
+        if(strncmp(argv[i], "--sort=", 7) == 0){
+            if(!parse_sort_order(argv[i] + 7, sort_order)){
+                fprintf(stderr, "Unknown sort order '%s' (name, size, mtime, version)\n", argv[i] + 7);
+                return 1;
+            }
+            continue;
+        }
+        if(strncmp(argv[i], "--exclude=", 10) == 0){name_filter.excludes.add(argv[i] + 10); continue;}
+        if(strncmp(argv[i], "--include=", 10) == 0){name_filter.includes.add(argv[i] + 10); continue;}
+        if(strcmp(argv[i], "--max-depth") == 0){max_depth = MAX_TRAVERSE_DEPTH; continue;}
+        // -L N / -LN, N >= 1; the next argument is only taken if it is a number.
+        if(strncmp(argv[i], "-L", 2) == 0){
+            const char* val = argv[i][2] ? argv[i] + 2 : (i+1 < argc ? argv[i+1] : "");
+            if(!parse_count(val, max_depth)){
+                fprintf(stderr, "-L needs a depth of at least 1 (got '%s')\n", val);
+                return 1;
+            }
+            if(!argv[i][2]){++i;}
+            continue;
+        }
+        // -j N / -jN; a bare -j (not followed by a number) uses every core.
+        if(strncmp(argv[i], "-j", 2) == 0){
+            if(argv[i][2]){
+                if(!parse_count(argv[i] + 2, worker_cnt)){
+                    fprintf(stderr, "Bad worker count '%s' for -j\n", argv[i] + 2);
+                    return 1;
+                }
+            }
+            else if(i+1 < argc && parse_count(argv[i+1], worker_cnt)){++i;}
+            else{worker_cnt = std::max(1u, std::thread::hardware_concurrency());}
+            continue;
+        }
+        roots.push_back(argv[i]);
+    }
+    FLAG_COLOR = color_mode > 0 || (color_mode == 0 && isatty(STDOUT_FILENO));
+    if(FLAG_COLOR){
+        if(const char* spec = getenv("LS_COLORS")){colors.parse(spec);}
+    }
+    if(top_n){
+        if(du_mode != DuMode::NONE || FLAG_WATCH || out_format != OutFormat::TREE || FLAG_UNSORTED || sort_mem){
+            fprintf(stderr, "--top cannot be combined with --du, --watch, --format, -U or --sort-mem\n");
+            return 1;
+        }
+        du_mode = DuMode::TOP;
+    }
+    // Record formats carry size/blocks and --sort=size/mtime compares them,
+    // so they need real stats too.
+    FLAG_BLOCKS = !FLAG_FAST || blocks_requested || du_mode != DuMode::NONE || FLAG_HARDLINKS || columns ||
+                  out_format != OutFormat::TREE || sort_order == SortOrder::SIZE || sort_order == SortOrder::MTIME;
+    if(FLAG_WATCH && du_mode != DuMode::NONE){
+        fprintf(stderr, "--du cannot be combined with --watch\n");
+        return 1;
+    }
+    if(out_format != OutFormat::TREE && (FLAG_WATCH || du_mode != DuMode::NONE)){
+        fprintf(stderr, "--format=ndjson/binary cannot be combined with --watch or --du\n");
+        return 1;
+    }
+    if((FLAG_UNSORTED || sort_mem) && (FLAG_WATCH || du_mode != DuMode::NONE || index_writer)){
+        fprintf(stderr, "-U/--sort-mem cannot be combined with --watch, --du or --index\n");
+        return 1;
+    }
+    if(index_writer && (name_filter.active() || FLAG_GITIGNORE)){
+        fprintf(stderr, "--index cannot be combined with --exclude/--include/--gitignore\n");
+        return 1;
+    }
+    raise_fd_limit();
+    if(FLAG_WATCH){
+        if(roots.size() != 1){
+            fprintf(stderr, "--watch takes exactly one directory\n");
+            return 1;
+        }
+        reset_color();
+        int ret = watch_directory(roots[0]);
+        stdout_buf.flush();
+        if(stats_enabled){print_stats(stderr, stats_json, stat_clock() - start_ns);}
+        return ret == 0 && !stdout_buf.failed() ? 0 : 1;
+    }
+    if(out_format == OutFormat::BINARY){out->append(BIN_MAGIC, sizeof(BIN_MAGIC));}
+    bool ok = list_roots(roots);
+    if(du_mode == DuMode::TOP){print_top();}
+    stdout_buf.flush();
+    if(stats_enabled){print_stats(stderr, stats_json, stat_clock() - start_ns);}
+    if(index_writer && !index_writer->finish()){
+        fprintf(stderr, "Unable to save index : %s\n", strerror(errno));
+        return 1;
+    }
+    return ok && !stdout_buf.failed() ? 0 : 1;
+}
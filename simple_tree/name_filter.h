@@ -0,0 +1,101 @@
+#ifndef NAME_FILTER_H
+#define NAME_FILTER_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "entry_table.h"
+
+/**
+ * A set of shell globs matched against bare entry names. Patterns are
+ * sorted into classes once, when they are added: plain names go into a hash
+ * set, "foo*" and "*.o" become prefix/suffix compares, and only the rest
+ * are handed to fnmatch(). Several patterns may be given in one string,
+ * separated by '|' (as in tree -I "node_modules|.git").
+ */
+class GlobSet{
+public:
+    void add(const char* spec){
+        const char* p = spec;
+        while(true){
+            const char* bar = strchr(p, '|');
+            std::string pat = bar ? std::string(p, bar - p) : std::string(p);
+            if(!pat.empty()){compile(pat);}
+            if(!bar){break;}
+            p = bar + 1;
+        }
+    }
+
+    bool empty() const{
+        return literals.empty() && prefixes.empty() && suffixes.empty() && globs.empty();
+    }
+
+    bool match(const char* name, size_t len) const{
+        if(!literals.empty() && literals.count(std::string(name, len))){return true;}
+        for(auto& s : prefixes){
+            if(len >= s.size() && memcmp(name, s.data(), s.size()) == 0){return true;}
+        }
+        for(auto& s : suffixes){
+            if(len >= s.size() && memcmp(name + len - s.size(), s.data(), s.size()) == 0){return true;}
+        }
+        for(auto& g : globs){
+            if(fnmatch(g.c_str(), name, 0) == 0){return true;}
+        }
+        return false;
+    }
+
+private:
+    std::unordered_set<std::string> literals;
+    std::vector<std::string> prefixes, suffixes, globs;
+
+    static bool has_magic(const std::string& s){
+        return s.find_first_of("*?[\\") != std::string::npos;
+    }
+
+    void compile(const std::string& pat){
+        if(!has_magic(pat)){literals.insert(pat); return;}
+        if(pat.back() == '*' && !has_magic(pat.substr(0, pat.size() - 1))){
+            prefixes.push_back(pat.substr(0, pat.size() - 1));
+        }
+        else if(pat[0] == '*' && !has_magic(pat.substr(1))){suffixes.push_back(pat.substr(1));}
+        else{globs.push_back(pat);}
+    }
+};
+
+/**
+ * --exclude / --include filters. Excluded names (files or directories) are
+ * dropped right after readdir, so an excluded subtree is never stat()ed or
+ * opened. --include keeps only the non-directories matching one of its
+ * patterns; directories are always descended.
+ */
+class NameFilter{
+public:
+    GlobSet excludes, includes;
+
+    bool active() const{return !excludes.empty() || !includes.empty();}
+
+    // Before stats: drops excluded names, and non-matching entries whose
+    // d_type already shows they are not directories.
+    void prune_unstated(EntryTable& tbl) const{
+        tbl.remove_if([&](const EntryRec& r){
+            const char* name = tbl.name(r);
+            if(excludes.match(name, r.name_len)){return true;}
+            if(includes.empty() || r.dtype == DT_DIR || r.dtype == DT_UNKNOWN){return false;}
+            return !includes.match(name, r.name_len);
+        });
+    }
+
+    // After stats: the include check for entries that had no d_type.
+    void prune_stated(EntryTable& tbl) const{
+        if(includes.empty()){return;}
+        tbl.remove_if([&](const EntryRec& r){
+            return r.dtype == DT_UNKNOWN && !S_ISDIR(r.mode) && !includes.match(tbl.name(r), r.name_len);
+        });
+    }
+};
+
+#endif
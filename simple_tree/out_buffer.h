@@ -0,0 +1,107 @@
+#ifndef OUT_BUFFER_H
+#define OUT_BUFFER_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <charconv>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "run_stats.h"
+
+/**
+ * Append-only output buffer that bypasses stdio. Everything is copied once
+ * into a large buffer and handed to the kernel with write()/writev() in big
+ * chunks. Short writes, EINTR and non-blocking pipes (EAGAIN) are handled;
+ * once the reader goes away (EPIPE) further output is dropped and failed()
+ * reports it.
+ */
+class OutBuffer{
+public:
+    static const size_t DEFAULT_CAPACITY = 1 << 20;
+
+    OutBuffer(int out_fd, size_t capacity = DEFAULT_CAPACITY) : fd(out_fd){
+        buf.resize(capacity);
+    }
+
+    ~OutBuffer(){flush();}
+
+    void append(const char* data, size_t n){
+        if(len + n <= buf.size()){
+            memcpy(buf.data() + len, data, n);
+            len += n;
+            return;
+        }
+        // Large pieces go out together with what is buffered, without copying.
+        if(n >= buf.size() / 2){
+            struct iovec iov[2] = {{buf.data(), len}, {const_cast<char*>(data), n}};
+            write_all(iov, 2);
+            len = 0;
+            return;
+        }
+        flush();
+        memcpy(buf.data(), data, n);
+        len = n;
+    }
+
+    void append(const std::string& s){append(s.data(), s.size());}
+    void append(const char* s){append(s, strlen(s));}
+
+    void put(char c){
+        if(len == buf.size()){flush();}
+        buf[len++] = c;
+    }
+
+    template<typename Int>
+    void append_int(Int v){
+        char tmp[24];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        append(tmp, res.ptr - tmp);
+    }
+
+    void flush(){
+        if(len == 0){return;}
+        struct iovec iov = {buf.data(), len};
+        write_all(&iov, 1);
+        len = 0;
+    }
+
+    bool failed() const{return broken;}
+
+private:
+    int fd;
+    std::vector<char> buf;
+    size_t len = 0;
+    bool broken = false;
+
+    void write_all(struct iovec* iov, int cnt){
+        while(cnt > 0 && !broken){
+            uint64_t t0 = stat_start();
+            ssize_t n = writev(fd, iov, cnt);
+            stat_end(OP_WRITE, t0, n != -1);
+            if(n > 0 && fd == STDOUT_FILENO){stat_count(CNT_STDOUT_BYTES, n);}
+            if(n == -1){
+                if(errno == EINTR){continue;}
+                if(errno == EAGAIN){
+                    struct pollfd pfd = {fd, POLLOUT, 0};
+                    poll(&pfd, 1, -1);
+                    continue;
+                }
+                broken = true;
+                return;
+            }
+            while(cnt > 0 && (size_t)n >= iov->iov_len){
+                n -= iov->iov_len;
+                ++iov; --cnt;
+            }
+            if(cnt > 0){
+                iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                iov->iov_len -= n;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef RECORD_FORMAT_H
+#define RECORD_FORMAT_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include "entry_table.h"
+#include "out_buffer.h"
+
+/*
+ * Machine-readable output, one record per entry in print order.
+ *
+ * ndjson: {"path":"...","depth":N,"type":"file","size":N,"blocks":N}
+ *         plus "target":"..." for symlinks. ", \ and control characters
+ *         are escaped and valid UTF-8 is passed through. Names are bytes,
+ *         though: if one is not valid UTF-8, the bad bytes become U+FFFD
+ *         and the exact bytes follow in base64 as "path_b64" (or
+ *         "target_b64"), so every line stays strict JSON.
+ *
+ * binary: BIN_MAGIC, then per entry a BinRecord followed by path_len bytes
+ *         of path and link_len bytes of symlink target (no terminators).
+ *         rec_len is the size of everything after itself, so readers can
+ *         skip records they do not understand. Native endianness.
+ */
+enum class OutFormat{TREE, NDJSON, BINARY};
+
+const char BIN_MAGIC[8] = {'S', 'T', 'R', 'E', 'E', 'B', 'I', 'N'};
+
+enum BinType : uint8_t{
+    BIN_OTHER = 0, BIN_FILE, BIN_DIR, BIN_LINK, BIN_FIFO, BIN_SOCK, BIN_CHAR, BIN_BLOCK
+};
+
+struct BinRecord{
+    uint32_t rec_len;
+    uint8_t  type;     // BinType
+    uint8_t  reserved;
+    uint16_t depth;
+    uint32_t path_len, link_len;
+    int64_t  size, blocks;
+};
+
+inline uint8_t bin_type(uint32_t mode){
+    if(S_ISREG(mode)){return BIN_FILE;}
+    if(S_ISDIR(mode)){return BIN_DIR;}
+    if(S_ISLNK(mode)){return BIN_LINK;}
+    if(S_ISFIFO(mode)){return BIN_FIFO;}
+    if(S_ISSOCK(mode)){return BIN_SOCK;}
+    if(S_ISCHR(mode)){return BIN_CHAR;}
+    if(S_ISBLK(mode)){return BIN_BLOCK;}
+    return BIN_OTHER;
+}
+
+// Length of the well-formed UTF-8 sequence starting at s (lead byte >=
+// 0x80), or 0 if there is none: no overlong forms, surrogates or code
+// points above U+10FFFF.
+inline size_t utf8_seq_len(const unsigned char* s, size_t n){
+    unsigned char c = s[0];
+    size_t len;
+    unsigned char lo = 0x80, hi = 0xbf; // allowed range of the second byte
+    if(c >= 0xc2 && c <= 0xdf){len = 2;}
+    else if(c >= 0xe0 && c <= 0xef){
+        len = 3;
+        if(c == 0xe0){lo = 0xa0;}
+        else if(c == 0xed){hi = 0x9f;}
+    }
+    else if(c >= 0xf0 && c <= 0xf4){
+        len = 4;
+        if(c == 0xf0){lo = 0x90;}
+        else if(c == 0xf4){hi = 0x8f;}
+    }
+    else{return 0;}
+    if(n < len || s[1] < lo || s[1] > hi){return 0;}
+    for(size_t i=2;i<len;++i){
+        if((s[i] & 0xc0) != 0x80){return 0;}
+    }
+    return len;
+}
+
+// Writes s as a JSON string. Returns false if s was not valid UTF-8 and
+// some bytes had to be replaced by U+FFFD.
+inline bool append_json_string(OutBuffer& out, const char* s, size_t n){
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(s);
+    bool exact = true;
+    out.put('"');
+    size_t run = 0; // start of the bytes that need no escaping
+    for(size_t i=0;i<n;++i){
+        unsigned char c = u[i];
+        if(c >= 0x80){
+            size_t len = utf8_seq_len(u + i, n - i);
+            if(len){
+                i += len - 1;
+                continue;
+            }
+            out.append(s + run, i - run);
+            run = i + 1;
+            out.append("\\ufffd", 6);
+            exact = false;
+            continue;
+        }
+        if(c >= 0x20 && c != '"' && c != '\\'){continue;}
+        out.append(s + run, i - run);
+        run = i + 1;
+        if(c == '"' || c == '\\'){out.put('\\'); out.put(c); continue;}
+        char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+        out.append(esc, 6);
+    }
+    out.append(s + run, n - run);
+    out.put('"');
+    return exact;
+}
+
+inline void append_base64_string(OutBuffer& out, const char* s, size_t n){
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(s);
+    out.put('"');
+    for(size_t i=0;i<n;i+=3){
+        uint32_t v = u[i] << 16 | (i + 1 < n ? u[i+1] << 8 : 0) | (i + 2 < n ? u[i+2] : 0);
+        char quad[4] = {digits[v >> 18], digits[(v >> 12) & 63],
+                        i + 1 < n ? digits[(v >> 6) & 63] : '=', i + 2 < n ? digits[v & 63] : '='};
+        out.append(quad, 4);
+    }
+    out.put('"');
+}
+
+inline void append_ndjson(OutBuffer& out, const std::string& path, int depth,
+                          const EntryTable& tbl, const EntryRec& fe){
+    static const char* const type_names[] = {
+        "other", "file", "dir", "link", "fifo", "sock", "char", "block"
+    };
+    out.append("{\"path\":", 8);
+    if(!append_json_string(out, path.data(), path.size())){
+        out.append(",\"path_b64\":", 12);
+        append_base64_string(out, path.data(), path.size());
+    }
+    out.append(",\"depth\":", 9);
+    out.append_int(depth);
+    out.append(",\"type\":\"", 9);
+    out.append(type_names[bin_type(fe.mode)]);
+    out.append("\",\"size\":", 9);
+    out.append_int(fe.size);
+    out.append(",\"blocks\":", 10);
+    out.append_int(fe.blocks);
+    if(S_ISLNK(fe.mode)){
+        out.append(",\"target\":", 10);
+        if(!append_json_string(out, tbl.link(fe), fe.link_len)){
+            out.append(",\"target_b64\":", 14);
+            append_base64_string(out, tbl.link(fe), fe.link_len);
+        }
+    }
+    out.append("}\n", 2);
+}
+
+inline void append_binary(OutBuffer& out, const std::string& path, int depth,
+                          const EntryTable& tbl, const EntryRec& fe){
+    BinRecord r;
+    r.rec_len = sizeof(BinRecord) - sizeof(r.rec_len) + path.size() + fe.link_len;
+    r.type = bin_type(fe.mode);
+    r.reserved = 0;
+    r.depth = depth;
+    r.path_len = path.size();
+    r.link_len = fe.link_len;
+    r.size = fe.size;
+    r.blocks = fe.blocks;
+    out.append(reinterpret_cast<const char*>(&r), sizeof(r));
+    out.append(path);
+    if(fe.link_len){out.append(tbl.link(fe), fe.link_len);}
+}
+
+#endif
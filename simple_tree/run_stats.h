@@ -0,0 +1,158 @@
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <time.h>
+
+/*
+ * --stats: per-operation call counts, errors, total time and a log2 latency
+ * histogram, plus a few plain counters. Every thread records into its own
+ * block (no shared cache lines, no atomics); the blocks are only summed
+ * when the report is printed. With --stats off, an instrumented call costs
+ * one well-predicted branch.
+ */
+enum StatOp{
+    OP_GETDENTS, OP_STAT, OP_URING_BATCH, OP_READLINK, OP_OPEN, OP_WRITE, // syscalls
+    OP_SCAN, OP_SORT, OP_PRINT, OP_LIST,                                  // phases
+    OP_COUNT
+};
+
+enum StatCounter{
+    CNT_ENTRIES, CNT_DIRS, CNT_URING_STATS, CNT_COLORS, CNT_STDOUT_BYTES, CNT_LINK_CACHE_HITS,
+    CNT_HARDLINK_INODES, CNT_INODE_SET_BYTES, // --hardlinks: InodeSet size at the end of each root
+    CNT_COUNT
+};
+
+const char* const STAT_OP_NAMES[OP_COUNT] = {
+    "getdents", "fstatat", "uring_statx", "readlinkat", "open", "write",
+    "scan_dir", "sort", "print_entry", "list_root"
+};
+
+const char* const STAT_COUNTER_NAMES[CNT_COUNT] = {
+    "entries", "directories", "uring_stats", "color_changes", "stdout_bytes", "link_cache_hits",
+    "hardlinked_inodes", "inode_set_bytes"
+};
+
+const int STAT_BUCKETS = 40; // bucket b: latencies below 2^b ns
+
+struct OpStats{
+    uint64_t calls, errors, total_ns, max_ns;
+    uint64_t hist[STAT_BUCKETS];
+};
+
+struct ThreadStats{
+    OpStats ops[OP_COUNT];
+    uint64_t counters[CNT_COUNT];
+};
+
+inline bool stats_enabled = false;
+inline std::mutex stats_mtx;
+inline std::vector<std::unique_ptr<ThreadStats>> stats_blocks;
+
+inline ThreadStats& thread_stats(){
+    thread_local ThreadStats* mine = nullptr;
+    if(!mine){
+        std::lock_guard<std::mutex> lock(stats_mtx);
+        stats_blocks.push_back(std::make_unique<ThreadStats>());
+        mine = stats_blocks.back().get();
+    }
+    return *mine;
+}
+
+inline uint64_t stat_clock(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// stat_start() ... stat_end(op, t0, ok) around one operation; t0 is 0 when
+// --stats is off and stat_end() then does nothing.
+inline uint64_t stat_start(){return stats_enabled ? stat_clock() : 0;}
+
+inline void stat_end(StatOp op, uint64_t t0, bool ok = true){
+    if(!t0){return;}
+    uint64_t ns = stat_clock() - t0;
+    OpStats& s = thread_stats().ops[op];
+    ++s.calls;
+    s.errors += !ok;
+    s.total_ns += ns;
+    if(ns > s.max_ns){s.max_ns = ns;}
+    int b = ns ? 64 - __builtin_clzll(ns) : 0;
+    ++s.hist[b < STAT_BUCKETS ? b : STAT_BUCKETS - 1];
+}
+
+inline void stat_count(StatCounter c, uint64_t n = 1){
+    if(stats_enabled){thread_stats().counters[c] += n;}
+}
+
+// Upper bound (ns) of the bucket holding the q-quantile.
+inline uint64_t stat_quantile(const OpStats& s, double q){
+    uint64_t want = s.calls * q, seen = 0;
+    for(int b=0;b<STAT_BUCKETS;++b){
+        seen += s.hist[b];
+        if(seen > want){return std::min(1ULL << b, (unsigned long long)s.max_ns);}
+    }
+    return s.max_ns;
+}
+
+// Sums every thread's block and prints the report (text or JSON) to f.
+inline void print_stats(FILE* f, bool json, uint64_t wall_ns){
+    ThreadStats sum = {};
+    {
+        std::lock_guard<std::mutex> lock(stats_mtx);
+        for(auto& t : stats_blocks){
+            for(int op=0;op<OP_COUNT;++op){
+                OpStats& d = sum.ops[op];
+                const OpStats& s = t->ops[op];
+                d.calls += s.calls;
+                d.errors += s.errors;
+                d.total_ns += s.total_ns;
+                if(s.max_ns > d.max_ns){d.max_ns = s.max_ns;}
+                for(int b=0;b<STAT_BUCKETS;++b){d.hist[b] += s.hist[b];}
+            }
+            for(int c=0;c<CNT_COUNT;++c){sum.counters[c] += t->counters[c];}
+        }
+    }
+    double secs = wall_ns / 1e9;
+    double rate = secs > 0 ? sum.counters[CNT_ENTRIES] / secs : 0;
+    if(json){
+        fprintf(f, "{\"wall_ns\":%llu,\"entries_per_sec\":%.0f", (unsigned long long)wall_ns, rate);
+        for(int c=0;c<CNT_COUNT;++c){
+            fprintf(f, ",\"%s\":%llu", STAT_COUNTER_NAMES[c], (unsigned long long)sum.counters[c]);
+        }
+        fprintf(f, ",\"ops\":{");
+        for(int op=0;op<OP_COUNT;++op){
+            const OpStats& s = sum.ops[op];
+            fprintf(f, "%s\"%s\":{\"calls\":%llu,\"errors\":%llu,\"total_ns\":%llu,\"max_ns\":%llu,\"hist_log2_ns\":[",
+                    op ? "," : "", STAT_OP_NAMES[op], (unsigned long long)s.calls, (unsigned long long)s.errors,
+                    (unsigned long long)s.total_ns, (unsigned long long)s.max_ns);
+            int last = STAT_BUCKETS - 1;
+            while(last > 0 && !s.hist[last]){--last;}
+            for(int b=0;b<=last;++b){fprintf(f, "%s%llu", b ? "," : "", (unsigned long long)s.hist[b]);}
+            fprintf(f, "]}");
+        }
+        fprintf(f, "}}\n");
+        return;
+    }
+    fprintf(f, "wall %.3fs, %llu entries (%.0f/s)", secs, (unsigned long long)sum.counters[CNT_ENTRIES], rate);
+    for(int c=1;c<CNT_COUNT;++c){
+        fprintf(f, ", %s %llu", STAT_COUNTER_NAMES[c], (unsigned long long)sum.counters[c]);
+    }
+    fprintf(f, "\n%-12s %10s %8s %11s %9s %9s %9s %10s\n",
+            "op", "calls", "errors", "total ms", "avg us", "p50 us", "p99 us", "max us");
+    for(int op=0;op<OP_COUNT;++op){
+        const OpStats& s = sum.ops[op];
+        if(!s.calls){continue;}
+        fprintf(f, "%-12s %10llu %8llu %11.2f %9.2f %9.2f %9.2f %10.2f\n", STAT_OP_NAMES[op],
+                (unsigned long long)s.calls, (unsigned long long)s.errors, s.total_ns / 1e6,
+                s.total_ns / 1e3 / s.calls, stat_quantile(s, 0.5) / 1e3, stat_quantile(s, 0.99) / 1e3,
+                s.max_ns / 1e3);
+    }
+}
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef SPILL_SORT_H
+#define SPILL_SORT_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "entry_table.h"
+#include "entry_sort.h"
+#include "out_buffer.h"
+
+// Anonymous read/write file in $TMPDIR (or /tmp), gone once closed.
+inline int open_temp_file(){
+    const char* dir = getenv("TMPDIR");
+    if(!dir || !*dir){dir = "/tmp";}
+    int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if(fd == -1){
+        std::string name = std::string(dir) + "/simple_tree.XXXXXX";
+        fd = mkostemp(&name[0], O_CLOEXEC);
+        if(fd != -1){unlink(name.c_str());}
+    }
+    return fd;
+}
+
+/**
+ * External merge sort for listings too big for the --sort-mem budget. Each
+ * sorted batch of entries is appended to an unlinked temp file as a run of
+ * records (EntryRec, then the name and link bytes); merging then reads all
+ * runs back in parallel through small per-run buffers and hands out the
+ * entries one at a time in sorted order, so memory is bounded by the
+ * budget no matter how many entries the directory has.
+ */
+class SpillRuns{
+public:
+    SpillRuns(SortOrder o, bool rev) : order(o), reverse(rev) {}
+    ~SpillRuns(){if(fd != -1){close(fd);}}
+
+    // Writes tbl (already sorted) as one more run. False on I/O errors.
+    bool add_run(const EntryTable& tbl){
+        if(fd == -1 && !open_file()){return false;}
+        Run run;
+        run.off = offset;
+        for(auto& r : tbl.recs){
+            write_bytes(&r, sizeof(r));
+            write_bytes(tbl.name(r), r.name_len);
+            if(r.link_len){write_bytes(tbl.link(r), r.link_len);}
+        }
+        run.end = offset;
+        runs.push_back(std::move(run));
+        return !writer->failed();
+    }
+
+    // Switches from writing to merging; budget is split between the runs'
+    // read buffers.
+    bool start_merge(size_t budget){
+        writer->flush();
+        if(writer->failed()){return false;}
+        size_t bufsize = std::max<size_t>(budget / std::max<size_t>(runs.size(), 1), 1 << 12);
+        bufsize = std::min<size_t>(bufsize, 1 << 20);
+        for(size_t i=0;i<runs.size();++i){
+            runs[i].buf.resize(bufsize);
+            if(!advance(runs[i])){return false;}
+            if(runs[i].has_head){heap.push_back(i);}
+        }
+        std::make_heap(heap.begin(), heap.end(), heap_cmp());
+        return true;
+    }
+
+    // Appends the next entry in merged order to dst; false once every run is
+    // drained or a read failed (error() is then set).
+    bool next(EntryTable& dst){
+        if(heap.empty()){return false;}
+        std::pop_heap(heap.begin(), heap.end(), heap_cmp());
+        Run& run = runs[heap.back()];
+        dst.append_from(run.head, run.head[0]);
+        if(!advance(run)){
+            heap.clear();
+            return false;
+        }
+        if(run.has_head){std::push_heap(heap.begin(), heap.end(), heap_cmp());}
+        else{heap.pop_back();}
+        return true;
+    }
+
+    int error() const{return err;}
+    size_t run_count() const{return runs.size();}
+
+private:
+    struct Run{
+        uint64_t off, end;  // unread part of the run in the file
+        std::vector<char> buf;
+        size_t pos = 0, len = 0;
+        EntryTable head;    // current smallest entry of the run
+        bool has_head = false;
+    };
+
+    SortOrder order;
+    bool reverse;
+    int fd = -1, err = 0;
+    uint64_t offset = 0;
+    std::unique_ptr<OutBuffer> writer;
+    std::vector<Run> runs;
+    std::vector<size_t> heap; // run indices, smallest head on top
+
+    struct HeapCmp{
+        SpillRuns* self;
+        bool operator()(size_t a, size_t b) const{
+            const Run& ra = self->runs[a];
+            const Run& rb = self->runs[b];
+            return entry_before(rb.head, rb.head[0], ra.head, ra.head[0], self->order, self->reverse);
+        }
+    };
+    HeapCmp heap_cmp(){return HeapCmp{this};}
+
+    bool open_file(){
+        fd = open_temp_file();
+        if(fd == -1){err = errno; return false;}
+        writer = std::make_unique<OutBuffer>(fd);
+        return true;
+    }
+
+    void write_bytes(const void* p, size_t n){
+        writer->append(static_cast<const char*>(p), n);
+        offset += n;
+    }
+
+    // Makes sure n bytes of the run are buffered at pos; false at the end
+    // of the run or on a read error.
+    bool want(Run& run, size_t n){
+        if(run.len - run.pos >= n){return true;}
+        memmove(run.buf.data(), run.buf.data() + run.pos, run.len - run.pos);
+        run.len -= run.pos;
+        run.pos = 0;
+        if(run.buf.size() < n){run.buf.resize(n);}
+        while(run.len < n && run.off < run.end){
+            size_t room = std::min<uint64_t>(run.buf.size() - run.len, run.end - run.off);
+            ssize_t got = pread(fd, run.buf.data() + run.len, room, run.off);
+            if(got == -1 && errno == EINTR){continue;}
+            if(got <= 0){
+                err = got == -1 ? errno : EIO;
+                return false;
+            }
+            run.len += got;
+            run.off += got;
+        }
+        if(run.len < n){ // run ends inside a record
+            err = EIO;
+            return false;
+        }
+        return true;
+    }
+
+    // Loads the run's next record into head. False only on read errors.
+    bool advance(Run& run){
+        run.head.clear();
+        run.has_head = false;
+        if(run.pos == run.len && run.off == run.end){return true;}
+        EntryRec r;
+        if(!want(run, sizeof(r))){return false;}
+        memcpy(&r, run.buf.data() + run.pos, sizeof(r));
+        size_t n = sizeof(r) + r.name_len + r.link_len;
+        if(!want(run, n)){return false;}
+        const char* name = run.buf.data() + run.pos + sizeof(r);
+        run.head.append(r, name, name + r.name_len);
+        run.pos += n;
+        run.has_head = true;
+        return true;
+    }
+};
+
+#endif
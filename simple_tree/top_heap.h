@@ -0,0 +1,70 @@
+#ifndef TOP_HEAP_H
+#define TOP_HEAP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+struct TopItem{
+    int64_t key;
+    uint64_t ino, dev; // tie-break, so equal keys need no path to rank
+    std::string path;
+};
+
+/**
+ * The K highest-keyed items seen so far, as a min-heap of at most K items:
+ * an offer costs one compare against the smallest kept item, and
+ * O(log K) only if it gets in. Equal keys are ranked by inode (then path),
+ * so the kept set does not depend on the order items arrive in (or on
+ * which worker saw them), and whether an item gets in is known before its
+ * path is built: callers check wants() first.
+ */
+class TopHeap{
+public:
+    explicit TopHeap(size_t k = 0) : k(k) {}
+
+    bool wants(int64_t key, uint64_t ino, uint64_t dev) const{
+        if(!k){return false;}
+        if(items.size() < k){return true;}
+        const TopItem& low = items.front();
+        if(key != low.key){return key > low.key;}
+        return ino != low.ino ? ino < low.ino : dev <= low.dev;
+    }
+
+    void push(int64_t key, uint64_t ino, uint64_t dev, std::string path){
+        if(!wants(key, ino, dev)){return;}
+        TopItem item{key, ino, dev, std::move(path)};
+        if(items.size() == k){
+            if(!above(item, items.front())){return;}
+            std::pop_heap(items.begin(), items.end(), above);
+            items.back() = std::move(item);
+        }
+        else{items.push_back(std::move(item));}
+        std::push_heap(items.begin(), items.end(), above);
+    }
+
+    void merge(TopHeap& other){
+        for(auto& item : other.items){push(item.key, item.ino, item.dev, std::move(item.path));}
+        other.items.clear();
+    }
+
+    // The kept items, highest first; empties the heap.
+    std::vector<TopItem> take_sorted(){
+        std::sort_heap(items.begin(), items.end(), above);
+        return std::move(items);
+    }
+
+private:
+    size_t k;
+    std::vector<TopItem> items; // heap ordered by above(): front is the lowest ranked
+
+    static bool above(const TopItem& a, const TopItem& b){
+        if(a.key != b.key){return a.key > b.key;}
+        if(a.ino != b.ino){return a.ino < b.ino;}
+        if(a.dev != b.dev){return a.dev < b.dev;}
+        return a.path < b.path;
+    }
+};
+
+#endif
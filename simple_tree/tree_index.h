@@ -0,0 +1,205 @@
+#ifndef TREE_INDEX_H
+#define TREE_INDEX_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "entry_table.h"
+#include "out_buffer.h"
+
+/*
+ * On-disk index of directory listings, written by one run and mmap()ed by
+ * the next. Layout (native endianness, the file is a local cache):
+ *
+ *   IndexHeader
+ *   per directory: IndexDirHeader, path bytes, EntryRec[n_entries],
+ *                  names_len bytes of name arena (8-byte aligned)
+ *   IndexSlot[dir_count], sorted by path hash
+ *
+ * A listing is reused when the directory's dev/ino/mtime/ctime still match,
+ * i.e. nothing was created, removed or renamed in it since it was indexed.
+ */
+static_assert(sizeof(EntryRec) == 96, "bump INDEX_VERSION when EntryRec changes");
+
+const char INDEX_MAGIC[8] = {'S', 'T', 'R', 'E', 'E', 'I', 'D', 'X'};
+const uint32_t INDEX_VERSION = 1;
+
+struct IndexHeader{
+    char     magic[8];
+    uint32_t version, reserved;
+    uint64_t dir_count;
+    uint64_t table_off;
+};
+
+struct IndexDirHeader{
+    uint64_t dev, ino;
+    int64_t  mtime, ctime;
+    uint32_t mtime_nsec, ctime_nsec;
+    uint32_t path_len, n_entries;
+    uint32_t names_len;
+    uint32_t full_stats; // 1 if every entry was lstat()ed (not --fast)
+};
+
+struct IndexSlot{
+    uint64_t hash, offset;
+};
+
+inline uint64_t index_path_hash(const std::string& path){
+    uint64_t h = 1469598103934665603ULL; // FNV-1a
+    for(unsigned char c : path){h = (h ^ c) * 1099511628211ULL;}
+    return h;
+}
+
+inline bool same_dir_version(const IndexDirHeader& h, const struct stat& st){
+    return h.dev == (uint64_t)st.st_dev && h.ino == (uint64_t)st.st_ino
+        && h.mtime == st.st_mtim.tv_sec && h.mtime_nsec == (uint32_t)st.st_mtim.tv_nsec
+        && h.ctime == st.st_ctim.tv_sec && h.ctime_nsec == (uint32_t)st.st_ctim.tv_nsec;
+}
+
+// Read-only view of a previous run's index. Lookups only touch the mmap, so
+// any number of scanning threads may use it at once.
+class TreeIndex{
+public:
+    ~TreeIndex(){if(base){munmap(const_cast<char*>(base), size);}}
+
+    bool load(const char* file){
+        int fd = open(file, O_RDONLY | O_CLOEXEC);
+        if(fd == -1){return false;}
+        struct stat st;
+        if(fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(IndexHeader)){close(fd); return false;}
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(p == MAP_FAILED){return false;}
+        base = static_cast<const char*>(p);
+        size = st.st_size;
+
+        auto* hdr = reinterpret_cast<const IndexHeader*>(base);
+        if(memcmp(hdr->magic, INDEX_MAGIC, 8) != 0 || hdr->version != INDEX_VERSION
+           || hdr->table_off > size || hdr->dir_count > (size - hdr->table_off) / sizeof(IndexSlot)){
+            munmap(p, size);
+            base = nullptr;
+            return false;
+        }
+        slots = reinterpret_cast<const IndexSlot*>(base + hdr->table_off);
+        slot_cnt = hdr->dir_count;
+        return true;
+    }
+
+    // Fills tbl with the stored listing of path if the directory (whose
+    // current stat is st) has not changed since. need_stats asks for a
+    // listing whose entries were fully stat()ed.
+    bool lookup(const std::string& path, const struct stat& st, bool need_stats, EntryTable& tbl) const{
+        if(!base){return false;}
+        uint64_t h = index_path_hash(path);
+        const IndexSlot* it = std::lower_bound(slots, slots + slot_cnt, h,
+            [](const IndexSlot& s, uint64_t v){return s.hash < v;});
+        for(; it != slots + slot_cnt && it->hash == h; ++it){
+            if(it->offset + sizeof(IndexDirHeader) > size){return false;}
+            auto* dh = reinterpret_cast<const IndexDirHeader*>(base + it->offset);
+            const char* p = base + it->offset + sizeof(IndexDirHeader);
+            uint64_t rec_off = align8(sizeof(IndexDirHeader) + dh->path_len);
+            uint64_t end = it->offset + rec_off + (uint64_t)dh->n_entries * sizeof(EntryRec) + dh->names_len;
+            if(end > size){return false;}
+            if(dh->path_len != path.size() || memcmp(p, path.data(), path.size()) != 0){continue;}
+            if(!same_dir_version(*dh, st) || (need_stats && !dh->full_stats)){return false;}
+            auto* recs = reinterpret_cast<const EntryRec*>(base + it->offset + rec_off);
+            tbl.load(recs, dh->n_entries, reinterpret_cast<const char*>(recs + dh->n_entries), dh->names_len);
+            return true;
+        }
+        return false;
+    }
+
+    static uint64_t align8(uint64_t v){return (v + 7) & ~7ULL;}
+
+private:
+    const char* base = nullptr;
+    size_t size = 0;
+    const IndexSlot* slots = nullptr;
+    uint64_t slot_cnt = 0;
+};
+
+// Streams a new index to "<file>.tmp" and renames it over file on finish(),
+// so an interrupted run leaves the previous index intact.
+class IndexWriter{
+public:
+    bool open_file(const char* file){
+        final_name = file;
+        tmp_name = final_name + ".tmp";
+        fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if(fd == -1){return false;}
+        buf = std::make_unique<OutBuffer>(fd);
+        IndexHeader hdr = {};
+        write_bytes(&hdr, sizeof(hdr));
+        return true;
+    }
+
+    void add_dir(const std::string& path, const struct stat& st, bool full_stats, const EntryTable& tbl){
+        IndexDirHeader dh = {};
+        dh.dev = st.st_dev;
+        dh.ino = st.st_ino;
+        dh.mtime = st.st_mtim.tv_sec;
+        dh.mtime_nsec = st.st_mtim.tv_nsec;
+        dh.ctime = st.st_ctim.tv_sec;
+        dh.ctime_nsec = st.st_ctim.tv_nsec;
+        dh.path_len = path.size();
+        dh.n_entries = tbl.size();
+        dh.names_len = TreeIndex::align8(tbl.names_size());
+        dh.full_stats = full_stats;
+
+        table.push_back({index_path_hash(path), offset});
+        write_bytes(&dh, sizeof(dh));
+        write_bytes(path.data(), path.size());
+        pad8();
+        write_bytes(tbl.recs.data(), tbl.size() * sizeof(EntryRec));
+        write_bytes(tbl.names(), tbl.names_size());
+        pad8();
+    }
+
+    bool finish(){
+        if(fd == -1){return false;}
+        std::sort(table.begin(), table.end(), [](const IndexSlot& a, const IndexSlot& b){
+            return a.hash < b.hash;
+        });
+        IndexHeader hdr;
+        memcpy(hdr.magic, INDEX_MAGIC, 8);
+        hdr.version = INDEX_VERSION;
+        hdr.reserved = 0;
+        hdr.dir_count = table.size();
+        hdr.table_off = offset;
+        write_bytes(table.data(), table.size() * sizeof(IndexSlot));
+        buf->flush();
+        bool ok = !buf->failed() && pwrite(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr);
+        buf.reset();
+        ok = (close(fd) == 0) && ok;
+        fd = -1;
+        if(ok){ok = rename(tmp_name.c_str(), final_name.c_str()) == 0;}
+        else{unlink(tmp_name.c_str());}
+        return ok;
+    }
+
+private:
+    int fd = -1;
+    std::string final_name, tmp_name;
+    std::unique_ptr<OutBuffer> buf;
+    uint64_t offset = 0;
+    std::vector<IndexSlot> table;
+
+    void write_bytes(const void* p, size_t n){
+        buf->append(static_cast<const char*>(p), n);
+        offset += n;
+    }
+
+    void pad8(){
+        static const char zeros[8] = {0};
+        write_bytes(zeros, TreeIndex::align8(offset) - offset);
+    }
+};
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef URING_STAT_H
+#define URING_STAT_H
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <linux/io_uring.h>
+
+/**
+ * Minimal io_uring ring (raw syscalls, no liburing) used to issue the statx
+ * calls for a whole directory listing at once. On network and FUSE mounts
+ * this keeps up to QUEUE_DEPTH lookups in flight instead of paying one round
+ * trip per entry. If the kernel refuses the ring (ENOSYS, EPERM under
+ * seccomp, ...) ok() is false and callers stay on fstatat().
+ */
+class UringStat{
+public:
+    static const unsigned QUEUE_DEPTH = 256;
+
+    UringStat(){
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        int fd = syscall(__NR_io_uring_setup, QUEUE_DEPTH, &p);
+        if(fd == -1){return;}
+
+        sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single){sq_sz = cq_sz = std::max(sq_sz, cq_sz);}
+
+        sq_ptr = mmap(nullptr, sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if(sq_ptr == MAP_FAILED){close(fd); return;}
+        if(single){cq_ptr = sq_ptr;}
+        else{
+            cq_ptr = mmap(nullptr, cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if(cq_ptr == MAP_FAILED){munmap(sq_ptr, sq_sz); close(fd); return;}
+        }
+        sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = static_cast<struct io_uring_sqe*>(
+            mmap(nullptr, sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if(sqes == MAP_FAILED){
+            if(!single){munmap(cq_ptr, cq_sz);}
+            munmap(sq_ptr, sq_sz);
+            close(fd);
+            return;
+        }
+
+        char* sq = static_cast<char*>(sq_ptr);
+        char* cq = static_cast<char*>(cq_ptr);
+        sq_tail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask  = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cq_head  = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail  = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask  = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes     = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+        sq_entries = p.sq_entries;
+        ring_fd = fd;
+    }
+
+    ~UringStat(){
+        if(ring_fd == -1){return;}
+        munmap(sqes, sqes_sz);
+        if(cq_ptr != sq_ptr){munmap(cq_ptr, cq_sz);}
+        munmap(sq_ptr, sq_sz);
+        close(ring_fd);
+    }
+
+    bool ok() const{return ring_fd != -1;}
+
+    // statx(dirfd, names[i], flags, STATX_BASIC_STATS, &bufs[i]) for every i;
+    // res[i] is 0 or -errno. Returns false if the ring itself failed, in which
+    // case the caller should redo the batch synchronously.
+    bool statx_all(int dirfd, const std::vector<const char*>& names, int flags,
+                   struct statx* bufs, int* res){
+        size_t n = names.size(), next = 0, done = 0;
+        unsigned inflight = 0, to_submit = 0;
+        while(done < n){
+            unsigned tail = *sq_tail;
+            while(next < n && inflight < sq_entries){
+                unsigned idx = tail & sq_mask;
+                struct io_uring_sqe* sqe = &sqes[idx];
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = dirfd;
+                sqe->addr = reinterpret_cast<unsigned long>(names[next]);
+                sqe->len = STATX_BASIC_STATS;
+                sqe->off = reinterpret_cast<unsigned long>(&bufs[next]);
+                sqe->statx_flags = flags;
+                sqe->user_data = next;
+                sq_array[idx] = idx;
+                ++tail; ++next; ++inflight; ++to_submit;
+            }
+            __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+            int ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if(ret == -1){
+                if(errno == EINTR || errno == EAGAIN || errno == EBUSY){continue;}
+                return false;
+            }
+            to_submit -= ret;
+
+            unsigned head = *cq_head;
+            unsigned ctail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for(; head != ctail; ++head){
+                struct io_uring_cqe* cqe = &cqes[head & cq_mask];
+                res[cqe->user_data] = cqe->res < 0 ? cqe->res : 0;
+                --inflight; ++done;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+        return true;
+    }
+
+private:
+    int ring_fd = -1;
+    void* sq_ptr = nullptr;
+    void* cq_ptr = nullptr;
+    size_t sq_sz = 0, cq_sz = 0, sqes_sz = 0;
+    unsigned sq_entries = 0, sq_mask = 0, cq_mask = 0;
+    unsigned *sq_tail = nullptr, *sq_array = nullptr;
+    unsigned *cq_head = nullptr, *cq_tail = nullptr;
+    struct io_uring_sqe* sqes = nullptr;
+    struct io_uring_cqe* cqes = nullptr;
+};
+
+// Fills the fields simple_tree uses from a statx result.
+inline void statx_to_stat(const struct statx& sx, struct stat& st){
+    memset(&st, 0, sizeof(st));
+    st.st_mode   = sx.stx_mode;
+    st.st_ino    = sx.stx_ino;
+    st.st_dev    = makedev(sx.stx_dev_major, sx.stx_dev_minor);
+    st.st_nlink  = sx.stx_nlink;
+    st.st_uid    = sx.stx_uid;
+    st.st_gid    = sx.stx_gid;
+    st.st_size   = sx.stx_size;
+    st.st_blocks = sx.stx_blocks;
+    st.st_blksize = sx.stx_blksize;
+    st.st_atim.tv_sec  = sx.stx_atime.tv_sec;
+    st.st_atim.tv_nsec = sx.stx_atime.tv_nsec;
+    st.st_mtim.tv_sec  = sx.stx_mtime.tv_sec;
+    st.st_mtim.tv_nsec = sx.stx_mtime.tv_nsec;
+    st.st_ctim.tv_sec  = sx.stx_ctime.tv_sec;
+    st.st_ctim.tv_nsec = sx.stx_ctime.tv_nsec;
+}
+
+#endif